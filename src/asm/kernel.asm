@@ -84,7 +84,24 @@ _kernel_start:
 
     ; -------------------------------------------------
     ; Identity map 0–4 MiB
+    ; Com PSE (CPUID(1).EDX bit 3) basta uma PDE de 4 MiB e a
+    ; page_table_identity nem é usada; sem PSE, PT de 4 KiB.
     ; -------------------------------------------------
+    mov eax, 1
+    cpuid
+    test edx, (1 << 3)
+    jz .identity_pt
+
+    mov eax, cr4
+    or  eax, 0x10            ; CR4.PSE (bit 4)
+    mov cr4, eax
+
+    ; PDE[0] = página de 4 MiB em 0 (PS + RW + PRESENT)
+    mov ebx, page_directory_phys
+    mov dword [ebx + 0*4], 0x00000083
+    jmp .identity_done
+
+    .identity_pt:
     mov edi, page_table_identity_phys
     mov eax, 0x00000003      ; RW + PRESENT, base = 0
     mov ecx, 1024
@@ -101,6 +118,8 @@ _kernel_start:
     mov ebx, page_directory_phys
     mov [ebx + 0*4], eax
 
+    .identity_done:
+
     ; -------------------------------------------------
     ; High-half mapeando kernel físico para 0xC0000000 - 0xC0400000(4MB)
     ; -------------------------------------------------
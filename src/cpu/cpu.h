@@ -57,8 +57,145 @@
 #define CR0_CD             BIT(CR0_CD_BIT)
 #define CR0_PG             BIT(CR0_PG_BIT)
 
+/* Bits de controle em CR4 (subset principal) */
+#define CR4_PSE_BIT        4   /* Page Size Extensions      */
+#define CR4_PAE_BIT        5   /* Physical Address Extension*/
+#define CR4_PGE_BIT        7   /* Page Global Enable        */
+
+/* Bits de CPUID(1).EDX */
+#define CPUID1_EDX_PSE_BIT 3
+#define CPUID1_EDX_PAE_BIT 6
+#define CPUID1_EDX_PGE_BIT 13
+#define CPUID1_EDX_MSR_BIT 5
+#define CPUID1_EDX_PAT_BIT 16
+
+/* MSRs */
+#define MSR_IA32_PAT       0x277u
+
 __attribute__((noreturn)) void _wait(void);
 
+/* Executa CPUID para a folha 'leaf' e subfolha 'subleaf' */
+static inline void cpu_cpuid_count(uint32_t leaf, uint32_t subleaf,
+                                   uint32_t *eax, uint32_t *ebx,
+                                   uint32_t *ecx, uint32_t *edx)
+{
+    uint32_t a, b, c, d;
+    __asm__ __volatile__("cpuid"
+                         : "=a"(a), "=b"(b), "=c"(c), "=d"(d)
+                         : "a"(leaf), "c"(subleaf));
+    if (eax) *eax = a;
+    if (ebx) *ebx = b;
+    if (ecx) *ecx = c;
+    if (edx) *edx = d;
+}
+
+/* Executa CPUID para a folha 'leaf' (subfolha 0) */
+static inline void cpu_cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx,
+                             uint32_t *ecx, uint32_t *edx)
+{
+    cpu_cpuid_count(leaf, 0u, eax, ebx, ecx, edx);
+}
+
+/* Contador de ciclos (TSC) */
+static inline uint64_t cpu_rdtsc(void)
+{
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* Lê/escreve CR0 */
+static inline uint32_t cpu_read_cr0(void)
+{
+    uint32_t v;
+    __asm__ __volatile__("mov %%cr0, %0" : "=r"(v));
+    return v;
+}
+
+static inline void cpu_write_cr0(uint32_t v)
+{
+    __asm__ __volatile__("mov %0, %%cr0" :: "r"(v) : "memory");
+}
+
+/* Lê CR2 (endereço que causou o último #PF) */
+static inline uint32_t cpu_read_cr2(void)
+{
+    uint32_t v;
+    __asm__ __volatile__("mov %%cr2, %0" : "=r"(v));
+    return v;
+}
+
+/* Lê CR3 (diretório/PDPT ativo) */
+static inline uint32_t cpu_read_cr3(void)
+{
+    uint32_t v;
+    __asm__ __volatile__("mov %%cr3, %0" : "=r"(v));
+    return v;
+}
+
+/* Lê/escreve CR4 */
+static inline uint32_t cpu_read_cr4(void)
+{
+    uint32_t v;
+    __asm__ __volatile__("mov %%cr4, %0" : "=r"(v));
+    return v;
+}
+
+static inline void cpu_write_cr4(uint32_t v)
+{
+    __asm__ __volatile__("mov %0, %%cr4" :: "r"(v) : "memory");
+}
+
+/* Lê/escreve um MSR (exige CPUID.MSR) */
+static inline uint64_t cpu_rdmsr(uint32_t msr)
+{
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void cpu_wrmsr(uint32_t msr, uint64_t v)
+{
+    __asm__ __volatile__("wrmsr" :: "c"(msr), "a"((uint32_t)v),
+                         "d"((uint32_t)(v >> 32)) : "memory");
+}
+
+/* Grava e invalida todas as caches */
+static inline void cpu_wbinvd(void)
+{
+    __asm__ __volatile__("wbinvd" ::: "memory");
+}
+
+/* Testa um bit de CPUID(1).EDX */
+static inline int cpu_has_feature_edx(unsigned bit)
+{
+    uint32_t edx;
+    cpu_cpuid(1u, NULL, NULL, NULL, &edx);
+    return (int)((edx >> bit) & 1u);
+}
+
+/* Aguarda a próxima interrupção (um único hlt) e retorna. */
+static inline void cpu_halt(void)
+{
+    __asm__ __volatile__("hlt" ::: "memory");
+}
+
+/* Desabilita interrupções e devolve o EFLAGS anterior */
+static inline uint32_t cpu_irq_save(void)
+{
+    uint32_t flags;
+    __asm__ __volatile__("pushfl; popl %0; cli" : "=r"(flags) :: "memory");
+    return flags;
+}
+
+/* Reabilita interrupções apenas se estavam habilitadas em 'flags' */
+static inline void cpu_irq_restore(uint32_t flags)
+{
+    if (flags & (1u << EFLAGS_IF_BIT)) {
+        __asm__ __volatile__("sti" ::: "memory");
+    }
+}
+
 __attribute__((noreturn)) void _pause(void);
 
 #endif
\ No newline at end of file
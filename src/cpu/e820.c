@@ -21,7 +21,8 @@ static phys_region_t phys_entries[MAX_E820_ENTRIES];
 //Cria a estrutura que irá guardar em memória o mapa da memória
 static phys_map_t physmap;
 static uint64_t physmem_size=0;
-static size_t physmem_free=0;
+static uint64_t physmem_free=0;
+static uint64_t physmem_top=0;   // fim da região USABLE mais alta (pode passar de 4 GiB)
 
 
 void e820_collect_regions(e820_address_t *e820_address)
@@ -58,6 +59,9 @@ void e820_collect_regions(e820_address_t *e820_address)
         //Memória livre
         if (type == E820_TYPE_USABLE) {
             physmem_free += length;
+            if (base + length > physmem_top) {
+                physmem_top = base + length;
+            }
         }
         
         physmap.mem_map[i]=r;
@@ -71,26 +75,34 @@ uint64_t e820_memory_size(void)
 {    
     return physmem_size;
 }
-size_t e820_memory_free(void)
+uint64_t e820_memory_free(void)
 {    
     return physmem_free;
 }
 
+/* Endereço logo após a última região USABLE: é até aqui que o PMM
+ * precisa enxergar (o total de e820_memory_size() ignora os buracos). */
+uint64_t e820_memory_top(void)
+{
+    return physmem_top;
+}
+
 
 void e820_debug_print()
 {
     kprintf("\nEntradas E820 detectadas: %d\n", physmap.count);
 
     for (size_t i = 0; i < physmap.count; i++) {
-        uint32_t base32   = (uint32_t)physmap.mem_map[i].base;
-        uint32_t length32 = (uint32_t)physmap.mem_map[i].length;
+        uint64_t base     = physmap.mem_map[i].base;
+        uint64_t length   = physmap.mem_map[i].length;
         uint32_t type     = physmap.mem_map[i].type;
 
+        // kprintf só tem 32 bits: parte alta e baixa separadas
         kprintf(
-            "\nE820[%d]: base=0x%X length=0x%X tipo=%d ",
+            "\nE820[%d]: base=0x%X:%X length=0x%X:%X tipo=%d ",
             (int)i,
-            base32,
-            length32,
+            (uint32_t)(base >> 32), (uint32_t)base,
+            (uint32_t)(length >> 32), (uint32_t)length,
             type
         );
     }
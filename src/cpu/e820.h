@@ -72,7 +72,8 @@ static inline e820_type_t e820_to_phys(uint32_t t) {
 void e820_memory_init(e820_address_t *e820_address);
 
 uint64_t e820_memory_size(void);
-size_t e820_memory_free(void);
+uint64_t e820_memory_free(void);
+uint64_t e820_memory_top(void);
 size_t e820_regions_count();
 
 phys_region_t * e820_region_by_index(size_t index);
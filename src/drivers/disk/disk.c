@@ -7,6 +7,7 @@
 #include "../../klib/kprintf.h"
 #include "disk.h"
 #include "../../fs/file.h"
+#include "streamer.h"
 
 /* Portas padrão do canal primário */
 #define ATA_REG_DATA        0x1F0
@@ -80,6 +81,8 @@ void disk_search_and_init(void) {
     disk.type = DISK_TYPE_REAL;
     disk.sector_size = DISK_SECTOR_SIZE;
     disk.id = 0;
+
+    diskstreamer_init();
     disk.filesystem = fs_resolve(&disk);
 
 }
@@ -6,12 +6,22 @@
 
 #include "streamer.h"
 #include "../../mm/kheap.h"
+#include "../../mm/slab.h"
+#include "../../klib/panic.h"
 #include "../../config.h"
 #include <stdbool.h>
 #include "disk.h"
 #include "../../klib/kprintf.h"
 #include "../../terminal/kprint.h"
 
+static kmem_cache_t* disk_stream_cache;
+
+void diskstreamer_init(void)
+{
+    disk_stream_cache = kmem_cache_create("disk_stream", sizeof(struct disk_stream), 0, NULL);
+    if (!disk_stream_cache) panic("diskstreamer_init: cache");
+}
+
 struct disk_stream* diskstreamer_new(int disk_id)
 {
     struct disk_driver* disk = disk_get(disk_id);
@@ -20,7 +30,12 @@ struct disk_stream* diskstreamer_new(int disk_id)
         return 0;
     }
 
-    struct disk_stream* streamer = kzalloc(sizeof(struct disk_stream));
+    struct disk_stream* streamer = kmem_cache_alloc(disk_stream_cache);
+    if (!streamer)
+    {
+        return 0;
+    }
+
     streamer->pos = 0;
     streamer->disk = disk;
     return streamer;
@@ -86,5 +101,5 @@ int diskstreamer_read(struct disk_stream* stream, void* out, int total)
 
 void diskstreamer_close(struct disk_stream* stream)
 {
-    kfree(stream);
+    kmem_cache_free(disk_stream_cache, stream);
 }
\ No newline at end of file
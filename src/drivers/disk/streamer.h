@@ -14,6 +14,9 @@ struct disk_stream {
     struct disk_driver *disk;
 };
 
+/* Cria o cache de disk_stream (antes do primeiro fs_resolve) */
+void diskstreamer_init(void);
+
 struct disk_stream * diskstreamer_new(int disk_id);
 int diskstreamer_seek(struct disk_stream* stream, int pos);
 int diskstreamer_read(struct disk_stream* stream, void *out, int total);
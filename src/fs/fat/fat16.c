@@ -9,6 +9,8 @@
 #include "../../drivers/disk/disk.h"
 #include "../../drivers/disk/streamer.h"
 #include "../../mm/kheap.h"
+#include "../../mm/slab.h"
+#include "../../klib/panic.h"
 #include "../path.h"
 
 static struct fat_directory* fat16_load_directory_from_cluster_chain(struct disk_driver* disk, int start_cluster);
@@ -23,8 +25,20 @@ struct filesystem fat16_fs =
     .close = fat16_close
 };
 
+static kmem_cache_t* fat_item_cache;
+static kmem_cache_t* fat_file_descriptor_cache;
+static kmem_cache_t* fat_dir_entry_cache;
+
 struct filesystem * fat16_init() {
     kstrcpy(fat16_fs.name, "FAT16");
+
+    fat_item_cache            = kmem_cache_create("fat_item", sizeof(struct fat_item), 0, NULL);
+    fat_file_descriptor_cache = kmem_cache_create("fat_file_descriptor",
+                                                  sizeof(struct fat_file_descriptor), 0, NULL);
+    fat_dir_entry_cache       = kmem_cache_create("fat_dir_entry", sizeof(struct fat_dir_entry), 0, NULL);
+    if (!fat_item_cache || !fat_file_descriptor_cache || !fat_dir_entry_cache) {
+        panic("fat16_init: caches");
+    }
     return &fat16_fs;
 }
 
@@ -205,12 +219,13 @@ void fat16_get_full_relative_filename(struct fat_dir_entry *item, char *out, int
 struct fat_dir_entry *fat16_clone_directory_item(struct fat_dir_entry *item, int size)
 {
     struct fat_dir_entry *item_copy = 0;
-    if (size < sizeof(struct fat_dir_entry))
+    // o clone vem do cache de entradas: exatamente uma entrada
+    if (size != sizeof(struct fat_dir_entry))
     {
         return 0;
     }
 
-    item_copy = kzalloc(size);
+    item_copy = kmem_cache_alloc(fat_dir_entry_cache);
     if (!item_copy)
     {
         return 0;
@@ -500,10 +515,10 @@ void fat16_fat_item_free(struct fat_item *item)
     }
     else if (item->type == FAT_ITEM_TYPE_FILE)
     {
-        kfree(item->item);
+        kmem_cache_free(fat_dir_entry_cache, item->item);
     }
 
-    kfree(item);
+    kmem_cache_free(fat_item_cache, item);
 }
 
 int fat16_get_total_items_for_directory(struct disk_driver *disk, uint32_t directory_start_sector)
@@ -580,13 +595,13 @@ struct fat_directory *fat16_load_fat_directory(struct disk_driver *disk, struct
 
 struct fat_item *fat16_new_fat_item_for_directory_item(struct disk_driver *disk, struct fat_dir_entry *item)
 {
-    struct fat_item *f_item = kzalloc(sizeof(struct fat_item));
+    struct fat_item *f_item = kmem_cache_zalloc(fat_item_cache);
     if (!f_item) return 0;
 
     if (item->attr & FAT_ATTR_DIRECTORY )
     {
         f_item->directory = fat16_load_fat_directory(disk, item);
-        if (!f_item->directory) { kfree(f_item); return 0; }
+        if (!f_item->directory) { kmem_cache_free(fat_item_cache, f_item); return 0; }
 
         f_item->type = FAT_ITEM_TYPE_DIRECTORY;
         return f_item;
@@ -594,7 +609,7 @@ struct fat_item *fat16_new_fat_item_for_directory_item(struct disk_driver *disk,
 
     f_item->type = FAT_ITEM_TYPE_FILE;
     f_item->item = fat16_clone_directory_item(item, sizeof(struct fat_dir_entry));
-    if (!f_item->item) { kfree(f_item); return 0; }
+    if (!f_item->item) { kmem_cache_free(fat_item_cache, f_item); return 0; }
 
     return f_item;
 }
@@ -921,7 +936,7 @@ void *fat16_open(struct disk_driver *disk, struct path_part *path, FILE_MODE mod
         goto err_out;
     }
 
-    descriptor = kzalloc(sizeof(struct fat_file_descriptor));
+    descriptor = kmem_cache_zalloc(fat_file_descriptor_cache);
     if (!descriptor)
     {
         err_code = -ENOMEM;
@@ -954,7 +969,7 @@ err_out:
     if (descriptor)
     {
         if (descriptor->item) fat16_fat_item_free(descriptor->item);
-        kfree(descriptor);
+        kmem_cache_free(fat_file_descriptor_cache, descriptor);
     }
     return ERR_PTR(err_code);
 }
@@ -1076,7 +1091,7 @@ out:
 static void fat16_free_file_descriptor(struct fat_file_descriptor* desc)
 {
     fat16_fat_item_free(desc->item);
-    kfree(desc);
+    kmem_cache_free(fat_file_descriptor_cache, desc);
 }
 
 int fat16_close(void* private_data)
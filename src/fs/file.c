@@ -8,6 +8,8 @@
 #include "../config.h"
 #include "../klib/memory.h"
 #include "../mm/kheap.h"
+#include "../mm/slab.h"
+#include "../klib/panic.h"
 #include "../klib/string.h"
 #include "../klib/kprintf.h"
 #include "../drivers/disk/disk.h"
@@ -20,6 +22,8 @@
 struct filesystem* filesystems[MAX_FILESYSTEMS];
 struct file_descriptor* file_descriptors[MAX_FILEDESCRIPTORS];
 
+static kmem_cache_t* file_descriptor_cache;
+
 /*
 Retorna o endereço do primeiro elemento vazio do vetor filesystems, 
 significando que ele está disponível.
@@ -69,13 +73,19 @@ void fs_load()
 void fs_init()
 {
     kmemset(file_descriptors, 0, sizeof(file_descriptors));
+
+    file_descriptor_cache = kmem_cache_create("file_descriptor",
+                                              sizeof(struct file_descriptor), 0, NULL);
+    if (!file_descriptor_cache) panic("fs_init: cache de descritores");
+    pathparser_init();
+
     fs_load();
 }
 
 static void file_free_descriptor(struct file_descriptor* desc)
 {
     file_descriptors[desc->index-1] = 0x00;
-    kfree(desc);
+    kmem_cache_free(file_descriptor_cache, desc);
 }
 
 /**
@@ -90,7 +100,7 @@ static int file_new_descriptor(struct file_descriptor** desc_out)
     {
         if (file_descriptors[i] == 0)
         {
-            struct file_descriptor* desc = kzalloc(sizeof(struct file_descriptor));
+            struct file_descriptor* desc = kmem_cache_zalloc(file_descriptor_cache);
             if (!desc)
                 return -ENOMEM;
 
@@ -244,7 +254,7 @@ out:
             // Se você quiser liberar desc, reative file_free_descriptor.
             // Por ora, evita “slot perdido” caso tenha sido reservado.
             file_descriptors[desc->index - 1] = 0;
-            kfree(desc);
+            kmem_cache_free(file_descriptor_cache, desc);
             desc = 0;
         }
 
@@ -9,11 +9,22 @@
 #include "../klib/ctype.h"
 #include "../klib/string.h"
 #include "../mm/kheap.h"
+#include "../mm/slab.h"
+#include "../klib/panic.h"
 #include "../klib/memory.h"
 #include "../status.h"
 #include "path.h"
 #include "../klib/kprintf.h"
 
+static kmem_cache_t* path_root_cache;
+static kmem_cache_t* path_part_cache;
+
+void pathparser_init(void)
+{
+    path_root_cache = kmem_cache_create("path_root", sizeof(struct path_root), 0, NULL);
+    path_part_cache = kmem_cache_create("path_part", sizeof(struct path_part), 0, NULL);
+    if (!path_root_cache || !path_part_cache) panic("pathparser_init: caches");
+}
 
 static int pathparser_path_valid_format(const char* filename)
 {
@@ -38,7 +49,7 @@ static int pathparser_get_drive_by_path(const char** path)
 
 static struct path_root* pathparser_create_root(int drive_number)
 {
-    struct path_root* path_r = kmalloc(sizeof(struct path_root));
+    struct path_root* path_r = kmem_cache_alloc(path_root_cache);
     //kprintf("\npath_root=%p",path_r);
     if (!path_r)
     {
@@ -95,7 +106,7 @@ struct path_part* pathparser_parse_path_part(struct path_part* last_part, const
         return 0;
     }
 
-    struct path_part* part = kmalloc(sizeof(struct path_part));
+    struct path_part* part = kmem_cache_alloc(path_part_cache);
     if (!part)
     {
         kfree((void*)path_part_str);
@@ -119,11 +130,11 @@ void pathparser_free(struct path_root* root)
     {
         struct path_part* next_part = part->next;
         kfree((void*) part->part);
-        kfree(part);
+        kmem_cache_free(path_part_cache, part);
         part = next_part;
     }
 
-    kfree(root);
+    kmem_cache_free(path_root_cache, root);
 }
 
 struct path_root* pathparser_parse(const char* path, const char* current_directory_path)
@@ -174,12 +185,12 @@ out:
     {
         if (path_root)
         {
-            kfree(path_root);
+            kmem_cache_free(path_root_cache, path_root);
             path_root = NULL;
         }
         if (first_part)
         {
-            kfree(first_part);
+            kmem_cache_free(path_part_cache, first_part);
         }
     }
     return path_root;
@@ -19,6 +19,9 @@ struct path_part
     struct path_part* next;
 };
 
+/* Cria os caches de path_root/path_part (chamada por fs_init) */
+void pathparser_init(void);
+
 struct path_root* pathparser_parse(const char* path, const char* current_directory_path);
 void pathparser_free(struct path_root* root);
 
@@ -1,6 +1,8 @@
 #include "exceptions.h"
 #include "../terminal/kprint.h"
 #include "../klib/panic.h"
+#include "../mm/page/page_fault.h"
+#include "../cpu/cpu.h"
 
 static const char *exception_names[] = {
     "#DE Divide Error",
@@ -36,6 +38,11 @@ const char * get_exception_name(uint32_t vector) {
 
 void handle_cpu_exception(uint32_t vector, int_stack_t *frame)
 {
+    // #PF em região sob demanda: resolvido, a instrução é repetida
+    if (vector == 14 && page_fault_handle(frame)) {
+        return;
+    }
+
     kprint("\n=== CPU EXCEPTION ===\n");
 
     if (vector < 32) {
@@ -47,6 +54,13 @@ void handle_cpu_exception(uint32_t vector, int_stack_t *frame)
     kprint("\nVetor: ");
     kprint_hex(vector);
 
+    if (vector == 14) {
+        kprint("\nCR2: ");
+        kprint_hex(cpu_read_cr2());
+        kprint(" Erro: ");
+        kprint_hex(frame ? frame->err_code : 0);
+    }
+
     // entrega ao sistema de pânico (que dá dump de registradores)
     panic_exception(vector, frame);
 }
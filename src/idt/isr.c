@@ -20,7 +20,8 @@ void isr_global_handler(int_stack_t *tsk_contxt)
     // 1) EXCEÇÕES DA CPU (0–31)
     if (vector < 32) {
         handle_cpu_exception(vector, tsk_contxt);
-        // NUNCA VOLTA (panic_exception é noreturn)
+        // só volta se a falta foi resolvida (#PF sob demanda)
+        return;
     }
 
     // 2) IRQs REMAPEADAS (32+)
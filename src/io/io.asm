@@ -5,6 +5,8 @@ global __write_portb
 global __write_portw
 global __read_portb
 global __read_portw
+global __write_portd
+global __read_portd
 
 __read_portb:
     push ebp
@@ -28,6 +30,16 @@ __read_portw:
     pop ebp
     ret
 
+__read_portd:
+    push ebp
+    mov ebp, esp
+
+    mov edx, [ebp+8]
+    in eax, dx
+
+    pop ebp
+    ret
+
 __write_portb:
 
     push ebp
@@ -50,4 +62,16 @@ __write_portw:
     out dx, ax
 
     pop ebp
-    ret
\ No newline at end of file
+    ret
+
+__write_portd:
+
+    push ebp
+    mov ebp, esp
+
+    mov eax, [ebp+12]
+    mov edx, [ebp+8]
+    out dx, eax
+
+    pop ebp
+    ret
@@ -14,6 +14,9 @@
 #include "./mm/mm.h"
 #include "./cpu/cpu.h"
 #include "./mm/page/paging.h"
+#include "./mm/page/page_fault.h"
+#include "./mm/page/paging_cache.h"
+#include "./mm/slab.h"
 #include "./drivers/disk/disk.h"
 #include "./drivers/disk/streamer.h"
 #include "./fs/path.h"
@@ -110,6 +113,13 @@ void kernel_main(void *e820_address) {
     //Inicializa a IDT
     idt_init();
 
+    // Com a IDT no lugar o #PF pode resolver regiões sob demanda
+    page_fault_init();
+
+#ifdef PAGING_COW_BENCH
+    paging_cow_bench();
+#endif
+
     // Setup the TSS
     kmemset(&tss_real, 0x00, sizeof(tss_real));
     tss_real.esp0 = _kernel_stack_top;
@@ -127,6 +137,8 @@ void kernel_main(void *e820_address) {
 
    
 
+    kheap_print_meta("boot");
+
     int fd = fopen("0:/hello.txt","r");
     kprintf("\n\nfd - phys address=%p", virt_to_phys_paging((uintptr_t)&fd));
     if(fd) {
@@ -157,6 +169,7 @@ void kernel_main(void *e820_address) {
         fclose(fd2);
         
     }
+    kheap_print_meta("abertura de arquivos");
             
 
     //Habilita o teclado
@@ -165,8 +178,20 @@ void kernel_main(void *e820_address) {
     
     kmemset(buf, 0xAA, 512);
 
-         
-    _wait();
+    pmm_zero_pool_print_stats();
+    paging_cache_print_stats();
+    page_fault_print_stats();
+    kheap_print_stats();
+    kmem_cache_print_stats();
+
+    // Laço ocioso: repõe o pool de frames zerados e os estoques de PTs e
+    // diretórios; só então executa hlt
+    for (;;) {
+        if (pmm_zero_pool_refill(PMM_ZERO_IDLE_BATCH) == 0 &&
+            paging_cache_refill(PAGING_CACHE_IDLE_BATCH) == 0) {
+            cpu_halt();
+        }
+    }
     
     
 }
\ No newline at end of file
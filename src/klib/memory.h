@@ -9,6 +9,7 @@
 #define CMP_MAIOR   1
 
 void * kmemset(void *ptr, char c, size_t size);
+void kmemzero(void *ptr, size_t size);
 void kmemcpy(void *dest, const void * src, size_t size);
 int kmemcmp(const void * s1, const void * s2, size_t count);
 
@@ -9,6 +9,8 @@
 #include "../klib/memory.h"
 #include "./page/paging.h"
 #include "./page/paging_kmap.h"
+#include "./page/page_fault.h"
+#include "vmalloc.h"
 #include "../klib/panic.h"
 #include "../klib/kprintf.h"
 
@@ -44,6 +46,19 @@ static uintptr_t heap_start_addr = 0;  // início da área de dados
 static uintptr_t heap_end_addr   = 0;  // fim atual (mapeado/útil)
 static uintptr_t heap_max_addr   = 0;  // limite máximo de dados (start + kheap_max_size)
 
+/* Fim do que map_heap_initial() mapeou com frames (além de heap_end_addr
+ * fica a folga): a expansão não remapeia esse trecho */
+static uintptr_t heap_premapped_end = 0;
+
+/* Páginas da área de dados com frame próprio (sem a página zero) */
+static size_t heap_resident_pages = 0;
+
+/* tamanhos globais em bytes/unidades apenas da ÁREA DE DADOS */
+static size_t kheap_initial_size    = 0;  // quanto começa ativo
+static size_t kheap_max_size        = 0;  // máximo possível de dados
+static size_t kheap_max_units       = 0;  // kheap_max_size / HEAP_UNIT
+
+#if !KHEAP_TLSF
 /* bitmap: 1 bit por unidade de HEAP_UNIT bytes dentro da área de dados */
 static uint32_t *heap_bitmap      = NULL;
 
@@ -51,14 +66,11 @@ static uint32_t *heap_bitmap      = NULL;
  * guarda quantas unidades esse bloco ocupa (0 = não é início). */
 static uint32_t *heap_alloc_units = NULL;
 
-/* tamanhos globais em bytes/unidades apenas da ÁREA DE DADOS */
-static size_t kheap_initial_size    = 0;  // quanto começa ativo
-static size_t kheap_max_size        = 0;  // máximo possível de dados
-static size_t kheap_max_units       = 0;  // kheap_max_size / HEAP_UNIT
 static size_t kheap_bitmap_size_u32 = 0;  // tamanho do bitmap em u32
 
 /* contador de unidades livres dentro da faixa atualmente mapeada */
 static size_t heap_free_units       = 0;
+#endif
 
 /* ----------------------------------------------------
  * Helpers de bitmap
@@ -80,6 +92,7 @@ static size_t heap_free_units       = 0;
 // }
 
 
+#if !KHEAP_TLSF
 static inline bool heap_unit_is_used(uint32_t unit_idx)
 {
     uint32_t word = heap_bitmap[HEAP_WORD_INDEX(unit_idx)];
@@ -95,6 +108,7 @@ static inline void heap_set_unit_free(uint32_t unit_idx)
 {
     heap_bitmap[HEAP_WORD_INDEX(unit_idx)] &= ~(1u << HEAP_BIT_OFFSET(unit_idx));
 }
+#endif
 
 /* unidades atualmente disponíveis dentro da área de dados mapeada */
 static inline uint32_t heap_current_total_units(void)
@@ -105,30 +119,560 @@ static inline uint32_t heap_current_total_units(void)
     return units;
 }
 
+/*
+ * Metadados do layout bitmap para uma região de 'region_bytes': bitmap +
+ * heap_alloc_units para o maior número de unidades (metade a cada
+ * tentativa) que ainda cabe junto com os dados. 0 se nada couber.
+ */
+static size_t heap_bitmap_layout(size_t region_bytes, size_t *units_out, size_t *bitmap_out)
+{
+    for (size_t units = region_bytes / HEAP_UNIT; units > 0; units /= 2) {
+        size_t bitmap_bytes = sizeof(uint32_t) * ((units + 31u) / 32u);
+        size_t meta_bytes   = (size_t)ALIGN_UP(bitmap_bytes + sizeof(uint32_t) * units, HEAP_UNIT);
+
+        if (meta_bytes < region_bytes && (region_bytes - meta_bytes) / HEAP_UNIT >= units) {
+            if (units_out)  *units_out  = units;
+            if (bitmap_out) *bitmap_out = bitmap_bytes;
+            return meta_bytes;
+        }
+    }
+    return 0;
+}
+
 static inline bool heap_is_initialized(void)
 {
+#if KHEAP_TLSF
+    return (heap_start_addr != 0 && heap_max_addr != 0);
+#else
     return (heap_start_addr != 0 && heap_max_addr != 0 && heap_bitmap && heap_alloc_units);
+#endif
+}
+
+#if KHEAP_TLSF
+/* ----------------------------------------------------
+ * TLSF (Two-Level Segregated Fit)
+ *
+ * Blocos com boundary tags, contíguos dentro da área de dados e
+ * terminados por uma sentinela (bloco usado de tamanho 0). Os livres
+ * ficam em listas por classe de tamanho: o 1º nível é a potência de 2
+ * (fls do tamanho) e o 2º divide cada potência em 2^KHEAP_TLSF_SL_LOG2
+ * faixas. Dois bitmaps dizem quais listas têm blocos, então achar um
+ * bloco que sirva custa dois ctz, e liberar une os vizinhos na hora.
+ * -------------------------------------------------- */
+
+/* Cabeçalho do bloco. Um bloco usado custa só a palavra 'size' (tamanho
+ * do payload com o estado nos bits 0-1): prev_phys é a última palavra do
+ * payload do bloco anterior e só vale quando ele está livre
+ * (BLOCK_PREV_FREE). next_free/prev_free só valem em blocos livres e
+ * ocupam o início do payload.
+ *
+ *   ... payload anterior | prev_phys | size | payload (8 alinhado) ...
+ *                        ^ bloco
+ *
+ * O payload + a palavra de tamanho ocupam múltiplos de HEAP_ALIGNMENT,
+ * então o tamanho de um payload é sempre 4 mod 8. */
+typedef struct heap_block {
+    struct heap_block *prev_phys;
+    size_t             size;
+    struct heap_block *next_free;
+    struct heap_block *prev_free;
+} heap_block_t;
+
+#define BLOCK_FREE      1u
+#define BLOCK_PREV_FREE 2u
+#define BLOCK_FLAGS     (BLOCK_FREE | BLOCK_PREV_FREE)
+
+#define BLOCK_HDR       offsetof(heap_block_t, next_free)   // bloco -> payload
+#define BLOCK_OVERHEAD  sizeof(size_t)                      // custo de um bloco usado
+#define BLOCK_SIZE_MIN  (sizeof(heap_block_t) - BLOCK_OVERHEAD)
+
+#define TLSF_ALIGN_LOG2 3u
+#define TLSF_SL_COUNT   (1u << KHEAP_TLSF_SL_LOG2)
+#define TLSF_FL_SHIFT   (KHEAP_TLSF_SL_LOG2 + TLSF_ALIGN_LOG2)
+#define TLSF_FL_COUNT   (KHEAP_TLSF_FL_MAX - TLSF_FL_SHIFT + 1u)
+#define TLSF_SMALL_SIZE (1u << TLSF_FL_SHIFT)
+#define BLOCK_SIZE_MAX  ((size_t)1u << KHEAP_TLSF_FL_MAX)
+
+_Static_assert(HEAP_ALIGNMENT == (1u << TLSF_ALIGN_LOG2), "TLSF espera HEAP_ALIGNMENT = 8");
+_Static_assert(TLSF_SL_COUNT <= 32u && TLSF_FL_COUNT <= 32u, "bitmaps do TLSF sao de 32 bits");
+
+static uint32_t      tlsf_fl_bitmap = 0;
+static uint32_t      tlsf_sl_bitmap[TLSF_FL_COUNT];
+static heap_block_t *tlsf_blocks[TLSF_FL_COUNT][TLSF_SL_COUNT];
+
+/* bytes de payload nos blocos livres */
+static size_t tlsf_free_bytes = 0;
+
+/* blocos na área de dados (sem a sentinela) e quantos estão em uso */
+static size_t tlsf_block_count = 0;
+static size_t tlsf_used_count  = 0;
+
+static inline uint32_t tlsf_fls(size_t v)
+{
+    return 31u - (uint32_t)__builtin_clz((uint32_t)v);
+}
+
+static inline size_t block_size(const heap_block_t *b)
+{
+    return b->size & ~(size_t)BLOCK_FLAGS;
+}
+
+static inline bool block_is_free(const heap_block_t *b)
+{
+    return (b->size & BLOCK_FREE) != 0u;
+}
+
+static inline void *block_payload(const heap_block_t *b)
+{
+    return (void *)((uintptr_t)b + BLOCK_HDR);
+}
+
+static inline heap_block_t *block_from_payload(const void *ptr)
+{
+    return (heap_block_t *)((uintptr_t)ptr - BLOCK_HDR);
+}
+
+static inline heap_block_t *block_next(const heap_block_t *b)
+{
+    return (heap_block_t *)((uintptr_t)block_payload(b) + block_size(b) - BLOCK_OVERHEAD);
+}
+
+/* Atualiza no bloco seguinte a marca (e o ponteiro) do estado de 'b' */
+static inline void block_link_next(heap_block_t *b)
+{
+    heap_block_t *next = block_next(b);
+    if (block_is_free(b)) {
+        next->prev_phys = b;
+        next->size     |= BLOCK_PREV_FREE;
+    } else {
+        next->size &= ~(size_t)BLOCK_PREV_FREE;
+    }
+}
+
+/* Lista exata onde um bloco livre de 'size' bytes é guardado */
+static inline void tlsf_mapping_insert(size_t size, uint32_t *fl, uint32_t *sl)
+{
+    if (size < TLSF_SMALL_SIZE) {
+        *fl = 0;
+        *sl = (uint32_t)(size / (TLSF_SMALL_SIZE / TLSF_SL_COUNT));
+    } else {
+        uint32_t f = tlsf_fls(size);
+        *sl = (uint32_t)(size >> (f - KHEAP_TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+        *fl = f - (TLSF_FL_SHIFT - 1u);
+    }
+}
+
+/* Arredonda 'size' para o início da próxima faixa: qualquer bloco da
+ * lista resultante serve sem precisar percorrê-la */
+static inline size_t tlsf_search_size(size_t size)
+{
+    if (size >= TLSF_SMALL_SIZE) {
+        size += ((size_t)1u << (tlsf_fls(size) - KHEAP_TLSF_SL_LOG2)) - 1u;
+    }
+    return size;
 }
 
+static void tlsf_insert_free(heap_block_t *b)
+{
+    uint32_t fl, sl;
+    tlsf_mapping_insert(block_size(b), &fl, &sl);
+
+    heap_block_t *head = tlsf_blocks[fl][sl];
+    b->prev_free = NULL;
+    b->next_free = head;
+    if (head) head->prev_free = b;
+    tlsf_blocks[fl][sl] = b;
+
+    tlsf_fl_bitmap     |= 1u << fl;
+    tlsf_sl_bitmap[fl] |= 1u << sl;
+    tlsf_free_bytes    += block_size(b);
+}
+
+static void tlsf_remove_free(heap_block_t *b)
+{
+    uint32_t fl, sl;
+    tlsf_mapping_insert(block_size(b), &fl, &sl);
+
+    if (b->prev_free) b->prev_free->next_free = b->next_free;
+    else              tlsf_blocks[fl][sl]     = b->next_free;
+    if (b->next_free) b->next_free->prev_free = b->prev_free;
+
+    if (!tlsf_blocks[fl][sl]) {
+        tlsf_sl_bitmap[fl] &= ~(1u << sl);
+        if (!tlsf_sl_bitmap[fl]) tlsf_fl_bitmap &= ~(1u << fl);
+    }
+    tlsf_free_bytes -= block_size(b);
+}
+
+/* Tira da lista um bloco livre com pelo menos 'size' bytes (NULL se não houver) */
+static heap_block_t *tlsf_take_free(size_t size)
+{
+    size_t search = tlsf_search_size(size);
+    if (search >= BLOCK_SIZE_MAX) return NULL;
+
+    uint32_t fl, sl;
+    tlsf_mapping_insert(search, &fl, &sl);
+
+    uint32_t sl_map = tlsf_sl_bitmap[fl] & (~0u << sl);
+    if (!sl_map) {
+        uint32_t fl_map = (fl + 1u < 32u) ? (tlsf_fl_bitmap & (~0u << (fl + 1u))) : 0u;
+        if (!fl_map) return NULL;
+
+        fl     = (uint32_t)__builtin_ctz(fl_map);
+        sl_map = tlsf_sl_bitmap[fl];
+    }
+    sl = (uint32_t)__builtin_ctz(sl_map);
+
+    heap_block_t *b = tlsf_blocks[fl][sl];
+    tlsf_remove_free(b);
+    return b;
+}
+
+/* Absorve o bloco seguinte (livre) em 'b' */
+static void tlsf_absorb_next(heap_block_t *b)
+{
+    heap_block_t *next = block_next(b);
+    tlsf_remove_free(next);
+    b->size += block_size(next) + BLOCK_OVERHEAD;
+    block_link_next(b);
+    tlsf_block_count--;
+}
+
+/* Une o bloco livre 'b' (fora das listas) com vizinhos livres */
+static heap_block_t *tlsf_coalesce(heap_block_t *b)
+{
+    if (b->size & BLOCK_PREV_FREE) {
+        heap_block_t *prev = b->prev_phys;
+        tlsf_remove_free(prev);
+        prev->size += block_size(b) + BLOCK_OVERHEAD;
+        tlsf_block_count--;
+        b = prev;
+    }
+    if (block_is_free(block_next(b))) tlsf_absorb_next(b);
+    else                              block_link_next(b);
+    return b;
+}
+
+/* Corta 'b' em 'size' bytes se a sobra comportar um bloco; a sobra
+ * (livre) é unida ao vizinho seguinte e volta às listas */
+static void tlsf_trim(heap_block_t *b, size_t size)
+{
+    if (block_size(b) < size + sizeof(heap_block_t)) return;
+
+    size_t rest_size = block_size(b) - size - BLOCK_OVERHEAD;
+    b->size = size | (b->size & BLOCK_FLAGS);
+
+    heap_block_t *rest = block_next(b);
+    rest->size = rest_size | BLOCK_FREE;
+    block_link_next(b);
+    tlsf_block_count++;
+
+    tlsf_insert_free(tlsf_coalesce(rest));
+}
+
+/* Tamanho de payload para um pedido de 'size' bytes (0 se grande demais) */
+static inline size_t tlsf_adjust_size(size_t size)
+{
+    if (size == 0 || size >= BLOCK_SIZE_MAX) return 0;
+    size = (size_t)ALIGN_UP(size + BLOCK_OVERHEAD, HEAP_ALIGNMENT) - BLOCK_OVERHEAD;
+    return (size < BLOCK_SIZE_MIN) ? BLOCK_SIZE_MIN : size;
+}
+
+/* Acrescenta [start, end) à heap. Na primeira chamada cria o bloco
+ * inicial; depois a antiga sentinela em start - BLOCK_HDR vira o
+ * cabeçalho do trecho novo. A sentinela nova fica em end - BLOCK_HDR. */
+static void tlsf_add_area(uintptr_t start, uintptr_t end)
+{
+    heap_block_t *b;
+
+    if (start == heap_start_addr) {
+        b = (heap_block_t *)start;
+        b->size = (end - start - BLOCK_HDR - BLOCK_OVERHEAD) | BLOCK_FREE;
+    } else {
+        b = (heap_block_t *)(start - BLOCK_HDR);
+        b->size = (end - start - BLOCK_OVERHEAD) | BLOCK_FREE | (b->size & BLOCK_PREV_FREE);
+    }
+    tlsf_block_count++;
+
+    block_next(b)->size = 0;
+    tlsf_insert_free(tlsf_coalesce(b));
+}
+
+/* Bloco usado que contém 'ptr', ou NULL se 'ptr' não veio do kmalloc */
+static heap_block_t *tlsf_used_block(void *ptr)
+{
+    uintptr_t addr = (uintptr_t)ptr;
+
+    if (addr < heap_start_addr + BLOCK_HDR || addr >= heap_end_addr ||
+        (addr & (HEAP_ALIGNMENT - 1u)) != 0u) {
+#ifdef KHEAP_DEBUG
+        kprintf("[kfree] ptr fora da heap/desalinhado: %p\n", ptr);
+#endif
+        return NULL;
+    }
+
+    // o tamanho tem de levar a um cabeçalho dentro da heap que veja 'b'
+    // como usado; se o anterior está livre, ele tem de terminar em 'b'
+    heap_block_t *b    = block_from_payload(ptr);
+    size_t        size = block_size(b);
+    bool          ok   = !block_is_free(b) && size >= BLOCK_SIZE_MIN &&
+                         ((size + BLOCK_OVERHEAD) & (HEAP_ALIGNMENT - 1u)) == 0u &&
+                         size <= heap_end_addr - addr;
+    if (ok) ok = !(block_next(b)->size & BLOCK_PREV_FREE);
+    if (ok && (b->size & BLOCK_PREV_FREE)) {
+        uintptr_t prev = (uintptr_t)b->prev_phys;
+        ok = prev >= heap_start_addr && prev < (uintptr_t)b &&
+             block_is_free(b->prev_phys) && block_next(b->prev_phys) == b;
+    }
+    if (!ok) {
+#ifdef KHEAP_DEBUG
+        kprintf("[kfree] ptr %p nao eh inicio de bloco (double free/corrupcao)\n", ptr);
+#endif
+        return NULL;
+    }
+    return b;
+}
+#if KHEAP_SHRINK
+/* ----------------------------------------------------
+ * Devolução de páginas livres
+ *
+ * Páginas inteiras dentro de blocos livres (depois do cabeçalho e dos
+ * ponteiros da lista) podem perder o frame: a faixa passa a ser uma
+ * região demand-zero e o #PF traz um frame zerado quando um bloco novo
+ * voltar a usá-la. O bitmap marca as páginas sem frame para as contas
+ * de marca d'água; alocar um bloco desmarca as páginas que ele cobre.
+ * -------------------------------------------------- */
+
+#define HEAP_VA_PAGES ((PHYSMAP_BASE - KHEAP_BASE) / PAGE_SIZE)
+
+static uint32_t heap_released_map[(HEAP_VA_PAGES + 31u) / 32u];
+static size_t   heap_released_pages = 0;
+static size_t   heap_pages_returned = 0;
+static size_t   heap_shrink_passes  = 0;
+
+/* próximo gatilho: sobe depois de uma passada que não atingiu LOW */
+static size_t   heap_shrink_trigger = KHEAP_SHRINK_HIGH;
+
+static inline bool heap_page_released(size_t idx)
+{
+    return (heap_released_map[idx / 32u] >> (idx % 32u)) & 1u;
+}
+
+/* bytes livres que ainda têm frame */
+static inline size_t heap_resident_free(void)
+{
+    size_t released = heap_released_pages * PAGE_SIZE;
+    return (tlsf_free_bytes > released) ? tlsf_free_bytes - released : 0;
+}
+
+/* [from, to) vai ser usado de novo: as páginas sem frame ganham um
+ * agora, para que a falta de memória apareça como NULL no kmalloc e não
+ * como panic no #PF do primeiro acesso. false se o PMM não tiver frames
+ * (as páginas já cobertas continuam válidas). */
+static bool heap_touch(uintptr_t from, uintptr_t to)
+{
+    if (heap_released_pages == 0) return true;
+    if (to > heap_end_addr) to = heap_end_addr;
+
+    paging_ctx_t *ctx   = get_paging_ctx();
+    uint32_t      flags = KHEAP_PAGE_FLAGS | paging_kernel_global();
+
+    for (uintptr_t va = ALIGN_DOWN(from, PAGE_SIZE); va < to; va += PAGE_SIZE) {
+        size_t idx = (size_t)((va - heap_start_addr) / PAGE_SIZE);
+        if (!heap_page_released(idx)) continue;
+
+        // pode estar na página zero (foi lida): o mapeamento é trocado
+        phys_addr_t pa = pmm_alloc_zeroed_frame_for_va(va);
+        if (!pa) return false;
+        page_set_type(pa, PAGE_TYPE_HEAP);
+        if (paging_map(kernel_directory, ctx, va, pa, flags) != 0) {
+            pmm_free_frame(pa);
+            return false;
+        }
+
+        heap_released_map[idx / 32u] &= ~(1u << (idx % 32u));
+        heap_released_pages--;
+        heap_resident_pages++;
+    }
+    return true;
+}
+
+/* [from, to) (páginas inteiras) ficou sem frame */
+static void heap_mark_released(uintptr_t from, uintptr_t to)
+{
+    for (uintptr_t va = from; va < to; va += PAGE_SIZE) {
+        size_t idx = (size_t)((va - heap_start_addr) / PAGE_SIZE);
+        if (heap_page_released(idx)) continue;
+        heap_released_map[idx / 32u] |= 1u << (idx % 32u);
+        heap_released_pages++;
+    }
+}
+
+/* Tira o frame de [va, va + n páginas); devolve false se não conseguiu
+ * registrar a faixa como demand-zero */
+static bool heap_release_run(uintptr_t va, size_t n)
+{
+    uint32_t flags = KHEAP_PAGE_FLAGS | paging_kernel_global();
+
+    // a região da heap pode já existir (KHEAP_LAZY); senão, nasce aqui
+    for (size_t i = 0; i < n; ++i) {
+        uintptr_t page = va + (uintptr_t)i * PAGE_SIZE;
+        if (!vm_region_find(kernel_directory, page) &&
+            vm_region_add(kernel_directory, page, PAGE_SIZE, flags, PAGE_TYPE_HEAP) != 0) {
+            return false;
+        }
+    }
+
+    paging_ctx_t *ctx  = get_paging_ctx();
+    phys_addr_t   zero = page_fault_zero_frame();
+    for (size_t i = 0; i < n; ++i) {
+        phys_addr_t phys = paging_get_physical(kernel_directory, ctx, va + (uintptr_t)i * PAGE_SIZE);
+        if (!phys || phys == zero) continue;
+        if (heap_resident_pages) heap_resident_pages--;
+        if (phys_to_page(phys) && page_count(phys) == 1u) heap_pages_returned++;
+    }
+    paging_unmap_release(kernel_directory, ctx, va, n);
+    return true;
+}
+
+/* Devolve as páginas inteiras de um bloco livre até 'resident' <= LOW */
+static bool heap_release_block(heap_block_t *b, size_t *resident)
+{
+    uintptr_t first = ALIGN_UP((uintptr_t)b + sizeof(heap_block_t), PAGE_SIZE);
+    uintptr_t last  = ALIGN_DOWN((uintptr_t)block_next(b), PAGE_SIZE);
+    if (last <= first || (last - first) / PAGE_SIZE < KHEAP_SHRINK_MIN_PAGES) return true;
+
+    uintptr_t run = 0;
+    for (uintptr_t va = first; va <= last; va += PAGE_SIZE) {
+        size_t idx  = (size_t)((va - heap_start_addr) / PAGE_SIZE);
+        bool   stop = (va == last) || heap_page_released(idx) || *resident <= KHEAP_SHRINK_LOW;
+
+        if (!stop) {
+            if (!run) run = va;
+            *resident = (*resident > PAGE_SIZE) ? *resident - PAGE_SIZE : 0;
+            continue;
+        }
+        if (run) {
+            size_t n = (size_t)((va - run) / PAGE_SIZE);
+            if (!heap_release_run(run, n)) return false;
+
+            heap_mark_released(run, va);
+            run = 0;
+        }
+        if (*resident <= KHEAP_SHRINK_LOW) break;
+    }
+    return true;
+}
+
+/* Chamada pelo kfree: com livres residentes acima do gatilho, percorre
+ * as listas dos blocos maiores para os menores devolvendo páginas */
+static void heap_shrink(void)
+{
+    size_t resident = heap_resident_free();
+
+    // histerese: o gatilho só desce de volta quando os livres caem
+    size_t band = KHEAP_SHRINK_HIGH - KHEAP_SHRINK_LOW;
+    if (heap_shrink_trigger > KHEAP_SHRINK_HIGH && resident + band < heap_shrink_trigger) {
+        heap_shrink_trigger = (resident + band > KHEAP_SHRINK_HIGH) ? resident + band
+                                                                     : KHEAP_SHRINK_HIGH;
+    }
+    if (resident <= heap_shrink_trigger || !page_fault_enabled()) return;
+
+    heap_shrink_passes++;
+
+    size_t min_size = (size_t)(KHEAP_SHRINK_MIN_PAGES + 1u) * PAGE_SIZE;
+    uint32_t min_fl, min_sl;
+    tlsf_mapping_insert(min_size, &min_fl, &min_sl);
+
+    for (int32_t fl = (int32_t)TLSF_FL_COUNT - 1; fl >= (int32_t)min_fl; --fl) {
+        if (!(tlsf_fl_bitmap & (1u << fl))) continue;
+        for (int32_t sl = (int32_t)TLSF_SL_COUNT - 1; sl >= 0; --sl) {
+            for (heap_block_t *b = tlsf_blocks[fl][sl]; b; b = b->next_free) {
+                if (!heap_release_block(b, &resident) || resident <= KHEAP_SHRINK_LOW) goto out;
+            }
+        }
+    }
+
+out:
+    // não chegou a LOW (livres fragmentados): espera crescer uma faixa
+    resident = heap_resident_free();
+    if (resident > KHEAP_SHRINK_LOW) heap_shrink_trigger = resident + band;
+}
+#endif /* KHEAP_SHRINK */
+#endif /* KHEAP_TLSF */
+
 // -----------------------------------------------------------------------------
 // Mapeamento/zero de frames
 // -----------------------------------------------------------------------------
 
-static inline void zero_frame_phys(uintptr_t phys)
+static inline void map_pages_kernel(uintptr_t virt, const phys_addr_t *frames, size_t count)
 {
-    void* p = (void*)kmap(phys);
-    kmemset(p, 0, PAGE_SIZE);
-    kunmap();
+    paging_ctx_t *ctx=get_paging_ctx();
+    // paging_map_range agrupa as invalidações. flags de kernel RW + global.
+    if (paging_map_range(kernel_directory, ctx, virt, frames, count,
+                         KHEAP_PAGE_FLAGS | paging_kernel_global()) != 0) {
+        panic("kheap: paging_map failed");
+    }
 }
 
-static inline void map_page_kernel(uintptr_t virt, uintptr_t phys)
+/**
+ * Frames do próximo lote de 4 KiB a partir de 'va': no máximo
+ * KHEAP_FRAME_BATCH e sem atravessar a próxima fronteira de página
+ * grande, para que o trecho seguinte ainda possa usar uma.
+ */
+static size_t heap_batch_frames(uintptr_t va, uintptr_t end)
 {
-    paging_ctx_t *ctx=get_paging_ctx();
-    // paging_map já deve fazer invlpg. flags de kernel RW.
-    //if (paging_map(kernel_directory, &g_paging_ctx, virt, phys, KHEAP_PAGE_FLAGS) != 0) {
-    if (paging_map(kernel_directory, ctx, virt, phys, KHEAP_PAGE_FLAGS) != 0) {
-        panic("kheap: paging_map failed");
+    uintptr_t stop = end;
+
+#if KHEAP_LARGE_PAGES
+    if (paging_large_enabled()) {
+        uintptr_t next = (va | (paging_large_size() - 1u)) + 1u;
+        if (next > va && next < stop) stop = next;
+    }
+#endif
+
+    size_t want = (size_t)((stop - va) / PAGE_SIZE);
+    return (want > KHEAP_FRAME_BATCH) ? KHEAP_FRAME_BATCH : want;
+}
+
+/**
+ * Tenta mapear [va, va + paging_large_size()) com uma página grande.
+ * Devolve false se não houver suporte, se o trecho não estiver alinhado
+ * ou não couber antes de 'end', ou se o PMM não tiver o bloco contíguo; nesses
+ * casos o chamador segue com páginas de 4 KiB.
+ */
+static bool heap_map_large(uintptr_t va, uintptr_t end)
+{
+#if KHEAP_LARGE_PAGES
+    if (!paging_large_enabled()) return false;
+
+    uintptr_t large = paging_large_size();
+    if ((va & (large - 1)) || end - va < large) return false;
+
+    // PDE com PT (pré-alocada ou de um trecho de 4 KiB): nem pede o bloco
+    if (!paging_large_slot_free(kernel_directory, va)) return false;
+
+    unsigned order = paging_large_order();
+    phys_addr_t phys = pmm_alloc_frames(order);
+    if (!phys) return false;
+
+    if (paging_map_large(kernel_directory, get_paging_ctx(), va, phys,
+                         KHEAP_PAGE_FLAGS | paging_kernel_global()) != 0) {
+        pmm_free_frames(phys, order);
+        return false;
+    }
+
+    // bloco novo do PMM: zera pelo próprio mapeamento
+    kmemzero((void*)va, large);
+    for (uintptr_t off = 0; off < large; off += PAGE_SIZE) {
+        page_set_type(phys + off, PAGE_TYPE_HEAP);
     }
+    return true;
+#else
+    (void)va;
+    (void)end;
+    return false;
+#endif
 }
 
 /* ----------------------------------------------------
@@ -139,43 +683,130 @@ static inline void map_page_kernel(uintptr_t virt, uintptr_t phys)
 // Expansão da heap (PMM + paging_map)
 // -----------------------------------------------------------------------------
 
+/* passo da próxima expansão (dobra até KHEAP_GROW_MAX) */
+static size_t heap_grow_step = KHEAP_GROW_MIN;
+
+/* Páginas da área de dados sem frame próprio: o crescimento sob demanda
+ * e as devolvidas pelo shrink. Já são da heap, mas o PMM ainda as conta
+ * como livres. */
+static inline size_t heap_unbacked_pages(void)
+{
+    size_t pages = (size_t)((heap_end_addr - ALIGN_DOWN(heap_start_addr, PAGE_SIZE)) / PAGE_SIZE);
+    return (pages > heap_resident_pages) ? pages - heap_resident_pages : 0;
+}
+
+/**
+ * Tamanho da próxima expansão para 'need' bytes (já em páginas): o
+ * maior entre 'need' e o passo atual, limitado ao que resta da janela e
+ * aos frames livres do PMM acima de KHEAP_PMM_RESERVE, menos os que a
+ * heap já prometeu e ainda não usou. 0 se nem 'need' couber.
+ */
+static size_t heap_grow_size(size_t need, size_t room)
+{
+    if (need > room) return 0;
+
+    size_t step = (need > heap_grow_step) ? need : heap_grow_step;
+    if (step > room) step = (size_t)ALIGN_DOWN(room, PAGE_SIZE);
+
+    size_t free_frames = pmm_get_free_frame_count();
+    size_t held        = KHEAP_PMM_RESERVE + heap_unbacked_pages();
+    size_t avail       = (free_frames > held) ? free_frames - held : 0;
+    if (need / PAGE_SIZE > avail) return 0;
+    if (step / PAGE_SIZE > avail) step = avail * PAGE_SIZE;
+
+    return step;
+}
+
 static bool heap_expand(size_t bytes_needed)
 {
     if (bytes_needed == 0) return true;
     if (!heap_is_initialized()) return false;
 
-    size_t cur_size      = (size_t)(heap_end_addr - heap_start_addr);
-    size_t required_size = cur_size + bytes_needed;
-
-    if (required_size > kheap_max_size) {
+    size_t cur_size = (size_t)(heap_end_addr - heap_start_addr);
+    if (bytes_needed > kheap_max_size - cur_size) {
         return false;
     }
 
-    size_t new_size_rounded = (size_t)ALIGN_UP(required_size, PAGE_SIZE);
-    size_t delta            = new_size_rounded - cur_size;
-    if (delta == 0) return true;
+    size_t need  = (size_t)ALIGN_UP(cur_size + bytes_needed, PAGE_SIZE) - cur_size;
+    size_t delta = heap_grow_size(need, kheap_max_size - cur_size);
+    if (delta == 0) return false;
 
     uintptr_t vaddr     = heap_start_addr + (uintptr_t)cur_size;
     uintptr_t end_vaddr = vaddr + (uintptr_t)delta;
+    bool      lazy      = false;
+
+    // o começo pode estar na folga que map_heap_initial já mapeou
+    uintptr_t premapped = (heap_premapped_end > vaddr) ? heap_premapped_end : vaddr;
+    if (premapped > end_vaddr) premapped = end_vaddr;
+    heap_resident_pages += (size_t)((premapped - vaddr) / PAGE_SIZE);
+    vaddr = premapped;
+    uintptr_t map_from = vaddr;
+
+    phys_addr_t frames[KHEAP_FRAME_BATCH];
+
+#if KHEAP_LAZY
+    // sem tabela de regiões livre cai no mapeamento imediato
+    if (vaddr < end_vaddr && page_fault_enabled() &&
+        vm_region_add(kernel_directory, vaddr, (size_t)(end_vaddr - vaddr),
+                      KHEAP_PAGE_FLAGS | paging_kernel_global(), PAGE_TYPE_HEAP) == 0) {
+        vaddr = end_vaddr;
+        lazy  = true;
+    }
+#endif
 
     while (vaddr < end_vaddr) {
-        uintptr_t phys = pmm_alloc_frame();
-        if (!phys) {
-            // Ideal: rollback. Por ora, falha simples.
-            return false;
+        if (heap_map_large(vaddr, end_vaddr)) {
+            vaddr += paging_large_size();
+            continue;
         }
 
-        zero_frame_phys(phys);
-        map_page_kernel(vaddr, phys);
+        size_t want = heap_batch_frames(vaddr, end_vaddr);
 
-        vaddr += PAGE_SIZE;
+        size_t got = pmm_alloc_zeroed_frames_for_va(frames, want, vaddr);
+        if (got < want) {
+            // devolve o lote e o que já foi mapeado nesta expansão
+            for (size_t i = 0; i < got; ++i) {
+                pmm_free_frame(frames[i]);
+            }
+            paging_unmap_release(kernel_directory, get_paging_ctx(), map_from,
+                                 (size_t)((vaddr - map_from) / PAGE_SIZE));
+            heap_resident_pages -= (size_t)((map_from - (heap_start_addr + cur_size)) / PAGE_SIZE);
+            return false;
+        }
+
+        for (size_t i = 0; i < got; ++i) {
+            page_set_type(frames[i], PAGE_TYPE_HEAP);
+        }
+        map_pages_kernel(vaddr, frames, got);
+        vaddr += (uintptr_t)got * PAGE_SIZE;
     }
 
-    heap_end_addr = heap_start_addr + (uintptr_t)new_size_rounded;
+    if (!lazy) heap_resident_pages += (size_t)((end_vaddr - map_from) / PAGE_SIZE);
 
+    uintptr_t old_end = heap_end_addr;
+    heap_end_addr = heap_start_addr + (uintptr_t)(cur_size + delta);
+
+    if (heap_grow_step < KHEAP_GROW_MAX) heap_grow_step *= 2u;
+
+#if KHEAP_TLSF
+    tlsf_add_area(old_end, heap_end_addr);
+#if KHEAP_SHRINK
+    // o miolo do trecho sob demanda ainda não tem frame: entra na conta
+    // como devolvido (a 1ª e a última página levam cabeçalho/sentinela)
+    uintptr_t unbacked = (map_from > old_end + PAGE_SIZE) ? map_from : old_end + PAGE_SIZE;
+    if (lazy && unbacked + PAGE_SIZE < heap_end_addr) {
+        heap_mark_released(unbacked, heap_end_addr - PAGE_SIZE);
+    }
+#else
+    (void)lazy;
+#endif
+#else
+    (void)old_end;
+    (void)lazy;
     uint32_t old_units = (uint32_t)(cur_size / HEAP_UNIT);
-    uint32_t new_units = (uint32_t)(new_size_rounded / HEAP_UNIT);
+    uint32_t new_units = (uint32_t)((cur_size + delta) / HEAP_UNIT);
     heap_free_units   += (size_t)(new_units - old_units);
+#endif
 
     return true;
 }
@@ -219,48 +850,45 @@ void kheap_init(uint32_t region_start,
     uintptr_t region_end   = heap_region_start + (uintptr_t)heap_region_size;
     size_t    region_bytes = (size_t)(region_end - heap_region_start);
 
-    // chute inicial: máximo de unidades se tudo fosse dado
-    size_t max_units_guess = region_bytes / HEAP_UNIT;
-    if (max_units_guess == 0) {
+#if KHEAP_TLSF
+    // metadados ficam nos próprios blocos: a região inteira é dado
+    kheap_max_size  = (size_t)(region_bytes & ~(size_t)(PAGE_SIZE - 1));
+    kheap_max_units = kheap_max_size / HEAP_UNIT;
+    if (kheap_max_size < PAGE_SIZE) {
         panic("kheap_init: region too small");
     }
 
-    size_t meta_bytes   = 0;
-    size_t bitmap_bytes = 0;
-    size_t alloc_bytes  = 0;
-    size_t data_bytes   = 0;
-
-    // Ajusta kheap_max_units até caber (metadados + dados)
-    for (;;) {
-        kheap_max_units = max_units_guess;
-
-        bitmap_bytes = sizeof(uint32_t) * ((kheap_max_units + 31u) / 32u);
-        alloc_bytes  = sizeof(uint32_t) * kheap_max_units;
-
-        meta_bytes   = bitmap_bytes + alloc_bytes;
-        meta_bytes   = (size_t)ALIGN_UP(meta_bytes, HEAP_UNIT);
+    size_t init_bytes = (size_t)ALIGN_UP((size_t)initial_heap_size, PAGE_SIZE);
+    if (init_bytes == 0 || init_bytes > kheap_max_size) {
+        init_bytes = kheap_max_size;
+    }
+    kheap_initial_size = init_bytes;
 
-        if (meta_bytes >= region_bytes) {
-            max_units_guess /= 2;
-            if (max_units_guess == 0) {
-                panic("kheap_init: metadata doesn't fit");
-            }
-            continue;
-        }
+    heap_start_addr = heap_region_start;
+    heap_end_addr   = heap_start_addr + (uintptr_t)kheap_initial_size;
+    heap_max_addr   = heap_start_addr + (uintptr_t)kheap_max_size;
 
-        data_bytes = region_bytes - meta_bytes;
+#if KHEAP_SHRINK
+    // o mapa de páginas devolvidas cobre [KHEAP_BASE, PHYSMAP_BASE)
+    if (heap_start_addr < KHEAP_BASE || heap_max_addr > PHYSMAP_BASE) {
+        panic("kheap_init: region fora da janela da heap");
+    }
+#endif
 
-        if ((data_bytes / HEAP_UNIT) < kheap_max_units) {
-            max_units_guess /= 2;
-            if (max_units_guess == 0) {
-                panic("kheap_init: data area doesn't fit");
-            }
-            continue;
-        }
+    tlsf_add_area(heap_start_addr, heap_end_addr);
+#else
+    if (region_bytes / HEAP_UNIT == 0) {
+        panic("kheap_init: region too small");
+    }
 
-        break;
+    // Ajusta kheap_max_units até caber (metadados + dados)
+    size_t bitmap_bytes = 0;
+    size_t meta_bytes   = heap_bitmap_layout(region_bytes, &kheap_max_units, &bitmap_bytes);
+    if (meta_bytes == 0) {
+        panic("kheap_init: metadata doesn't fit");
     }
 
+    size_t data_bytes = region_bytes - meta_bytes;
     kheap_max_size = (data_bytes / HEAP_UNIT) * HEAP_UNIT;
 
     size_t init_bytes = (size_t)ALIGN_UP((size_t)initial_heap_size, PAGE_SIZE);
@@ -288,16 +916,247 @@ void kheap_init(uint32_t region_start,
     heap_max_addr   = heap_start_addr + (uintptr_t)kheap_max_size;
 
     heap_free_units = (size_t)heap_current_total_units();
+#endif /* KHEAP_TLSF */
+
+    // a parte ativa já foi mapeada com frames (map_heap_initial)
+    heap_resident_pages = (size_t)((heap_end_addr - ALIGN_DOWN(heap_start_addr, PAGE_SIZE)) / PAGE_SIZE);
 
 #ifdef KHEAP_DEBUG
     kprintf("[kheap] region_start=%p size=%u\n", (void*)heap_region_start, (unsigned)heap_region_size);
     kprintf("[kheap] data_start=%p end=%p max=%p\n", (void*)heap_start_addr, (void*)heap_end_addr, (void*)heap_max_addr);
-    kprintf("[kheap] units max=%u bitmap_u32=%u free_units=%u\n",
-            (unsigned)kheap_max_units,
-            (unsigned)kheap_bitmap_size_u32,
-            (unsigned)heap_free_units);
+    kprintf("[kheap] units max=%u free_units=%u\n",
+            (unsigned)kheap_max_units, (unsigned)kheap_get_free_units());
+#endif
+}
+// -----------------------------------------------------------------------------
+// Blocos grandes (vmalloc)
+// -----------------------------------------------------------------------------
+
+/* blocos grandes vivos e páginas deles; o tamanho de cada um fica na
+ * tabela de áreas do vmalloc */
+static size_t heap_large_live  = 0;
+static size_t heap_large_pages = 0;
+
+static inline bool heap_is_large(const void* ptr)
+{
+#if KHEAP_LARGE
+    return vmalloc_contains((uintptr_t)ptr);
+#else
+    (void)ptr;
+    return false;
 #endif
 }
+
+/**
+ * Pedido grande servido por páginas próprias. NULL se o pedido é
+ * pequeno, exige alinhamento acima de uma página ou o vmalloc não tem
+ * VA/slots; nesses casos o chamador segue pela heap.
+ */
+static void* heap_large_alloc(size_t size, size_t align)
+{
+#if KHEAP_LARGE
+    if (size < KHEAP_LARGE_MIN || align > PAGE_SIZE) return NULL;
+
+    void* ptr = vmalloc(size);
+    if (ptr) {
+        heap_large_live++;
+        heap_large_pages += vmalloc_size(ptr) / PAGE_SIZE;
+    }
+    return ptr;
+#else
+    (void)size;
+    (void)align;
+    return NULL;
+#endif
+}
+
+/* Desmapeia o bloco grande e devolve os frames; false se 'ptr' não é um */
+static bool heap_large_free(void* ptr)
+{
+    if (!heap_is_large(ptr)) return false;
+
+    size_t bytes = vmalloc_size(ptr);
+    if (bytes == 0) {
+#ifdef KHEAP_DEBUG
+        kprintf("[kfree] ptr %p no vmalloc nao eh bloco grande\n", ptr);
+#endif
+        return true;
+    }
+
+    vfree(ptr);
+    heap_large_live--;
+    heap_large_pages -= bytes / PAGE_SIZE;
+    return true;
+}
+
+/* krealloc de um bloco grande: fica onde está se ainda for grande e
+ * couber nas páginas; senão move (podendo voltar para a heap) */
+static void* heap_large_realloc(void* ptr, size_t new_size)
+{
+    size_t cur = vmalloc_size(ptr);
+    if (cur == 0) return NULL;
+    if (new_size <= cur && new_size >= KHEAP_LARGE_MIN) return ptr;
+
+    void* new_ptr = kmalloc(new_size);
+    if (!new_ptr) return NULL;
+
+    kmemcpy(new_ptr, ptr, (new_size < cur) ? new_size : cur);
+    heap_large_free(ptr);
+    return new_ptr;
+}
+
+// -----------------------------------------------------------------------------
+// Alocação (TLSF)
+// -----------------------------------------------------------------------------
+
+#if KHEAP_TLSF
+
+/* Bloco de 'size' bytes com o payload alinhado em 'align'. Um bloco
+ * alinhado vem de um livre maior: o trecho antes do alinhamento volta
+ * às listas como bloco próprio. Sem bloco que sirva, a heap cresce. */
+static void* heap_alloc(size_t size, size_t align)
+{
+    if (!heap_is_initialized()) return NULL;
+
+    void* large = heap_large_alloc(size, align);
+    if (large) return large;
+
+    size_t adjust = tlsf_adjust_size(size);
+    if (adjust == 0) return NULL;
+
+    // folga para o alinhamento + um bloco mínimo antes dele
+    size_t gap_min = sizeof(heap_block_t);
+    size_t want    = adjust;
+    if (align > HEAP_ALIGNMENT) {
+        want = tlsf_adjust_size(adjust + align + gap_min);
+        if (want == 0) return NULL;
+    }
+
+    heap_block_t *b;
+    while ((b = tlsf_take_free(want)) == NULL) {
+        // pior caso: o trecho novo não se une a nenhum livre
+        if (!heap_expand(tlsf_search_size(want) + 2u * BLOCK_HDR)) return NULL;
+    }
+
+    uintptr_t ptr     = (uintptr_t)block_payload(b);
+    uintptr_t aligned = ptr;
+    size_t    gap     = 0;
+
+    if (align > HEAP_ALIGNMENT) {
+        aligned = ALIGN_UP(ptr, align);
+        gap     = (size_t)(aligned - ptr);
+
+        if (gap && gap < gap_min) {
+            size_t offset = gap_min - gap;
+            if (offset < align) offset = align;
+            aligned = ALIGN_UP(aligned + offset, align);
+            gap     = (size_t)(aligned - ptr);
+        }
+    }
+
+#if KHEAP_SHRINK
+    // frames antes de escrever os cabeçalhos do corte: o bloco usado e o
+    // cabeçalho da sobra (nada foi escrito ainda; sem frame, 'b' volta)
+    uintptr_t touch_end = aligned + adjust + sizeof(heap_block_t);
+    uintptr_t block_end = (uintptr_t)block_next(b) + sizeof(heap_block_t);
+    if (!heap_touch(aligned - BLOCK_HDR, (touch_end < block_end) ? touch_end : block_end)) {
+        tlsf_insert_free(b);
+        return NULL;
+    }
+#endif
+
+    if (gap) {
+        // o começo vira um bloco livre e 'b' passa a começar alinhado
+        heap_block_t *lead = b;
+        size_t        full = block_size(lead);
+        b = (heap_block_t *)(aligned - BLOCK_HDR);
+        b->size    = full - gap;
+        lead->size = (gap - BLOCK_OVERHEAD) | BLOCK_FREE | (lead->size & BLOCK_PREV_FREE);
+        tlsf_block_count++;
+        tlsf_insert_free(tlsf_coalesce(lead));
+    }
+
+    b->size &= ~(size_t)BLOCK_FREE;
+    block_link_next(b);
+    tlsf_trim(b, adjust);
+    tlsf_used_count++;
+    return block_payload(b);
+}
+
+void* kmalloc(size_t size)
+{
+    return heap_alloc(size, HEAP_ALIGNMENT);
+}
+
+void* kmalloc_aligned(size_t size, size_t align)
+{
+    if (align & (align - 1u)) return NULL;
+    return heap_alloc(size, align);
+}
+
+void kfree(void* ptr)
+{
+    if (!heap_is_initialized() || !ptr) return;
+    if (heap_large_free(ptr)) return;
+
+    heap_block_t *b = tlsf_used_block(ptr);
+    if (!b) return;
+
+    b->size |= BLOCK_FREE;
+    tlsf_used_count--;
+    tlsf_insert_free(tlsf_coalesce(b));
+#if KHEAP_SHRINK
+    heap_shrink();
+#endif
+}
+
+void* krealloc(void* ptr, size_t new_size)
+{
+    if (!heap_is_initialized()) return NULL;
+
+    if (!ptr) return kmalloc(new_size);
+    if (new_size == 0) {
+        kfree(ptr);
+        return NULL;
+    }
+    if (heap_is_large(ptr)) return heap_large_realloc(ptr, new_size);
+
+    heap_block_t *b = tlsf_used_block(ptr);
+    if (!b) return NULL;
+
+    size_t cur    = block_size(b);
+    size_t adjust = tlsf_adjust_size(new_size);
+    if (adjust == 0) return NULL;
+
+    // 1) cabe no bloco atual; 2) cresce sobre o vizinho livre
+    heap_block_t *next = block_next(b);
+    if (adjust > cur && block_is_free(next) && cur + BLOCK_OVERHEAD + block_size(next) >= adjust) {
+        tlsf_absorb_next(b);
+#if KHEAP_SHRINK
+        // sem frames para o trecho novo, o bloco volta ao tamanho antigo
+        if (!heap_touch((uintptr_t)next, (uintptr_t)block_payload(b) + adjust + sizeof(heap_block_t))) {
+            tlsf_trim(b, cur);
+            return NULL;
+        }
+#endif
+        cur = block_size(b);
+    }
+    if (adjust <= cur) {
+        tlsf_trim(b, adjust);
+        return ptr;
+    }
+
+    // 3) alocar novo e copiar
+    void* new_ptr = kmalloc(new_size);
+    if (!new_ptr) return NULL;
+
+    kmemcpy(new_ptr, ptr, cur);
+    kfree(ptr);
+    return new_ptr;
+}
+
+#else /* !KHEAP_TLSF */
+
 // -----------------------------------------------------------------------------
 // Alocação interna por unidades com alinhamento
 // -----------------------------------------------------------------------------
@@ -367,43 +1226,28 @@ void* kmalloc(size_t size)
 {
     if (!heap_is_initialized() || size == 0) return NULL;
 
+    void* large = heap_large_alloc(size, HEAP_ALIGNMENT);
+    if (large) return large;
+
     uint32_t units_needed = (uint32_t)((size + (HEAP_UNIT - 1u)) / HEAP_UNIT);
     return heap_alloc_units_aligned(units_needed, HEAP_ALIGNMENT, true);
 }
 
-void* kzalloc(size_t size)
-{
-    void* ptr = kmalloc(size);
-    if (!ptr) return NULL;
-    kmemset(ptr, 0, size);
-    return ptr;
-}
-
 void* kmalloc_aligned(size_t size, size_t align)
 {
     if (!heap_is_initialized() || size == 0) return NULL;
 
+    void* large = heap_large_alloc(size, align);
+    if (large) return large;
+
     uint32_t units_needed = (uint32_t)((size + (HEAP_UNIT - 1u)) / HEAP_UNIT);
     return heap_alloc_units_aligned(units_needed, (uint32_t)align, true);
 }
 
-void* kcalloc(size_t n, size_t size)
-{
-    if (!heap_is_initialized() || n == 0 || size == 0) return NULL;
-
-    size_t total = n * size;
-    if (total / n != size) return NULL; // overflow
-
-    void* ptr = kmalloc(total);
-    if (!ptr) return NULL;
-
-    kmemset(ptr, 0, total);
-    return ptr;
-}
-
 void kfree(void* ptr)
 {
     if (!heap_is_initialized() || !ptr) return;
+    if (heap_large_free(ptr)) return;
 
     uintptr_t addr = (uintptr_t)ptr;
 
@@ -450,6 +1294,7 @@ void* krealloc(void* ptr, size_t new_size)
         kfree(ptr);
         return NULL;
     }
+    if (heap_is_large(ptr)) return heap_large_realloc(ptr, new_size);
 
     uintptr_t addr = (uintptr_t)ptr;
     if (addr < heap_start_addr || addr >= heap_end_addr) return NULL;
@@ -515,6 +1360,30 @@ void* krealloc(void* ptr, size_t new_size)
     return new_ptr;
 }
 
+#endif /* KHEAP_TLSF */
+
+void* kzalloc(size_t size)
+{
+    void* ptr = kmalloc(size);
+    if (!ptr) return NULL;
+    if (!heap_is_large(ptr)) kmemset(ptr, 0, size);     // vmalloc já entrega zerado
+    return ptr;
+}
+
+void* kcalloc(size_t n, size_t size)
+{
+    if (!heap_is_initialized() || n == 0 || size == 0) return NULL;
+
+    size_t total = n * size;
+    if (total / n != size) return NULL; // overflow
+
+    void* ptr = kmalloc(total);
+    if (!ptr) return NULL;
+
+    if (!heap_is_large(ptr)) kmemset(ptr, 0, total);
+    return ptr;
+}
+
 void* kpage_alloc(void)
 {
     return kmalloc_aligned(PAGE_SIZE, PAGE_SIZE);
@@ -532,13 +1401,138 @@ void* kpages_alloc(size_t num_pages)
 
 size_t kheap_get_free_units(void)
 {
+#if KHEAP_TLSF
+    return tlsf_free_bytes / HEAP_UNIT;
+#else
     return heap_free_units;
+#endif
 }
 
 size_t kheap_get_total_units(void)
 {
     return (size_t)heap_current_total_units();
 }
+
+/* Bytes de metadados do alocador em uso */
+static size_t heap_meta_bytes(void)
+{
+#if KHEAP_TLSF
+    // uma palavra por bloco; o primeiro e a sentinela ocupam BLOCK_HDR
+    size_t meta = tlsf_block_count * BLOCK_OVERHEAD + BLOCK_OVERHEAD + BLOCK_HDR;
+    meta += sizeof(tlsf_fl_bitmap) + sizeof(tlsf_sl_bitmap) + sizeof(tlsf_blocks);
+#if KHEAP_SHRINK
+    meta += sizeof(heap_released_map);
+#endif
+    return meta;
+#else
+    return (size_t)(heap_start_addr - heap_region_start);
+#endif
+}
+
+/* Blocos em uso */
+static size_t heap_used_blocks(void)
+{
+#if KHEAP_TLSF
+    return tlsf_used_count;
+#else
+    size_t   n     = 0;
+    uint32_t total = heap_current_total_units();
+    for (uint32_t u = 0; u < total; ++u) {
+        if (heap_alloc_units[u]) n++;
+    }
+    return n;
+#endif
+}
+
+/* Maior bloco livre da heap, em bytes */
+static size_t heap_largest_free(void)
+{
+    size_t best = 0;
+#if KHEAP_TLSF
+    // está na lista não vazia mais alta; dentro dela os tamanhos variam
+    if (!tlsf_fl_bitmap) return 0;
+    uint32_t fl = tlsf_fls(tlsf_fl_bitmap);
+    uint32_t sl = tlsf_fls(tlsf_sl_bitmap[fl]);
+    for (const heap_block_t *b = tlsf_blocks[fl][sl]; b; b = b->next_free) {
+        if (block_size(b) > best) best = block_size(b);
+    }
+#else
+    size_t   run   = 0;
+    uint32_t total = heap_current_total_units();
+    for (uint32_t u = 0; u < total; ++u) {
+        run = heap_unit_is_used(u) ? 0 : run + 1u;
+        if (run > best) best = run;
+    }
+    best *= HEAP_UNIT;
+#endif
+    return best;
+}
+
+/* 'part' em centésimos de porcento de 'whole', sem divisão de 64 bits */
+static unsigned heap_basis_points(size_t part, size_t whole)
+{
+    if (whole == 0) return 0;
+    if (part <= 0xFFFFFFFFu / 10000u) return (unsigned)(part * 10000u / whole);
+    return (whole >= 10000u) ? (unsigned)(part / (whole / 10000u)) : 0xFFFFFFFFu;
+}
+
+void kheap_get_stats(kheap_stats_t* out)
+{
+    if (!out) return;
+    kmemset(out, 0, sizeof(*out));
+    if (!heap_is_initialized()) return;
+
+    out->size         = (size_t)(heap_end_addr - heap_start_addr);
+    out->free         = kheap_get_free_units() * HEAP_UNIT;
+    out->largest_free = heap_largest_free();
+    out->blocks       = heap_used_blocks();
+    out->meta         = heap_meta_bytes();
+    // base de comparação: a área de dados em uso, não a janela de VA
+    out->meta_bitmap  = heap_bitmap_layout(out->size, NULL, NULL);
+    out->large        = heap_large_live;
+    out->large_pages  = heap_large_pages;
+
+    // residente = páginas da área de dados com frame próprio
+    out->resident = heap_resident_pages * PAGE_SIZE;
+
+#if KHEAP_TLSF && KHEAP_SHRINK
+    out->released       = heap_released_pages;
+    out->pages_returned = heap_pages_returned;
+    out->shrinks        = heap_shrink_passes;
+#endif
+}
+
+void kheap_print_stats(void)
+{
+    kheap_stats_t st;
+    kheap_get_stats(&st);
+
+    kprintf("\nkheap: %u KiB de dados, %u KiB livres, %u KiB residentes",
+            (unsigned)(st.size >> 10), (unsigned)(st.free >> 10), (unsigned)(st.resident >> 10));
+    kprintf("\n  maior livre: %u KiB; blocos grandes (vmalloc): %u em %u paginas",
+            (unsigned)(st.largest_free >> 10), (unsigned)st.large, (unsigned)st.large_pages);
+    kprintf("\n  devolucao: %u paginas devolvidas ao PMM em %u passadas, %u livres sem frame",
+            (unsigned)st.pages_returned, (unsigned)st.shrinks, (unsigned)st.released);
+    kheap_print_meta("atual");
+}
+
+void kheap_print_meta(const char* label)
+{
+    kheap_stats_t st;
+    kheap_get_stats(&st);
+
+    unsigned now = heap_basis_points(st.meta, st.size);
+    unsigned old = heap_basis_points(st.meta_bitmap, st.size);
+    kprintf("\nkheap metadados (%s): %u blocos, %u bytes = %u.%02u%% de %u KiB"
+            " (layout bitmap: %u bytes = %u.%02u%%)",
+            label, (unsigned)st.blocks, (unsigned)st.meta, now / 100u, now % 100u,
+            (unsigned)(st.size >> 10), (unsigned)st.meta_bitmap, old / 100u, old % 100u);
+}
+void kheap_page_faulted_in(void)
+{
+    heap_resident_pages++;
+}
+
 /**
  * Faz o mapeamento inicial da área de memória definida para a heap.
  */
@@ -547,27 +1541,74 @@ void map_heap_initial(const paging_ctx_t* ctx, size_t bytes)
     uintptr_t va = KHEAP_BASE;
     uintptr_t end = KHEAP_BASE + ALIGN_UP(bytes, PAGE_SIZE);
 
-    for (; va < end; va += PAGE_SIZE) {
-        uintptr_t pa = pmm_alloc_frame();
-        if (!pa) panic("OOM: heap init frames");
+    phys_addr_t frames[KHEAP_FRAME_BATCH];
 
-        // zera frame via kmap (recomendado)
-        void* p = (void*)kmap(pa);
-        kmemset(p, 0, PAGE_SIZE);
-        kunmap();
-        //invalid_tlb((uintptr_t)p);
-        //kprintf("\nva=%p -> phys=%x",va,pa);
+    while (va < end) {
+        if (heap_map_large(va, end)) {
+            va += paging_large_size();
+            continue;
+        }
 
+        size_t want = heap_batch_frames(va, end);
 
-        if (paging_map(kernel_directory, ctx, va, pa, PAGE_RW) != 0) {
+        // frames já chegam zerados (pool ou kmap + clear)
+        if (pmm_alloc_zeroed_frames_for_va(frames, want, va) != want) panic("OOM: heap init frames");
+
+        for (size_t i = 0; i < want; ++i) {
+            page_set_type(frames[i], PAGE_TYPE_HEAP);
+        }
+        if (paging_map_range(kernel_directory, ctx, va, frames, want,
+                             KHEAP_PAGE_FLAGS | paging_kernel_global()) != 0) {
             panic("paging_map failed in heap init");
         }
+        va += (uintptr_t)want * PAGE_SIZE;
     }
+    heap_premapped_end = end;
 }
 
 
 #ifdef KHEAP_DEBUG
 
+#if KHEAP_TLSF
+
+void kheap_debug_dump_bitmap(void)
+{
+    if (!heap_is_initialized()) {
+        kprintf("kheap not initialized\n");
+        return;
+    }
+
+    kprintf("=== kheap TLSF bitmaps ===\n");
+    kprintf("fl_bitmap = 0x%08x, livres = %u bytes\n", tlsf_fl_bitmap, (unsigned)tlsf_free_bytes);
+    for (uint32_t fl = 0; fl < TLSF_FL_COUNT; ++fl) {
+        if (!tlsf_sl_bitmap[fl]) continue;
+        kprintf("  fl %2u: sl_bitmap = 0x%08x\n", fl, tlsf_sl_bitmap[fl]);
+    }
+    kprintf("=== fim dos bitmaps ===\n");
+}
+
+void kheap_debug_dump_blocks(void)
+{
+    if (!heap_is_initialized()) {
+        kprintf("kheap not initialized\n");
+        return;
+    }
+
+    kprintf("=== kheap blocks dump ===\n");
+    kprintf("heap_start_addr = %p\n", (void*)heap_start_addr);
+    kprintf("heap_end_addr   = %p\n", (void*)heap_end_addr);
+
+    // percorre as boundary tags até a sentinela
+    for (heap_block_t *b = (heap_block_t *)heap_start_addr; block_size(b) != 0; b = block_next(b)) {
+        kprintf("  bloco @ %p: bytes=%u, used=%s\n", block_payload(b),
+                (unsigned)block_size(b), block_is_free(b) ? "no" : "yes");
+    }
+
+    kprintf("=== fim dos blocos ===\n");
+}
+
+#else /* !KHEAP_TLSF */
+
 void kheap_debug_dump_bitmap(void)
 {
     if (!heap_is_initialized()) {
@@ -636,6 +1677,6 @@ void kheap_debug_dump_blocks(void)
     kprintf("=== fim dos blocos ===\n");
 }
 
-
+#endif /* KHEAP_TLSF */
 
 #endif /* KHEAP_DEBUG */
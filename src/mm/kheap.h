@@ -17,6 +17,10 @@
     |        ...           |
     +----------------------+  <- heap_max_addr
 
+Com KHEAP_TLSF não há bitmap nem heap_alloc_units: a área de dados começa
+em region_start e cada bloco carrega o próprio cabeçalho (boundary tag).
+Um bloco usado custa uma palavra; o resto dos metadados (listas, bitmaps
+do TLSF e o mapa de páginas devolvidas) tem tamanho fixo.
 */
 #ifndef KHEAP_H
 #define KHEAP_H
@@ -25,6 +29,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "./page/paging.h"
+#include "./page/paging_kmap.h"
 
 /* Granularidade básica da heap (cada unidade) */
 #ifndef HEAP_UNIT
@@ -40,12 +45,110 @@
 #define KHEAP_BASE 0xD0000000u
 #endif
 
+/* Janela virtual da heap, até o physmap */
+#ifndef KHEAP_WINDOW_SIZE
+#define KHEAP_WINDOW_SIZE (PHYSMAP_BASE - KHEAP_BASE)
+#endif
+
 #ifndef KHEAP_PAGE_FLAGS
 // flags típicos para páginas do kernel: RW + PRESENT é aplicado dentro de paging_map,
 // mas mantemos RW aqui e o map adiciona PRESENT.
 #define KHEAP_PAGE_FLAGS (PAGE_RW)
 #endif
 
+/* Quantos frames são pedidos de uma vez ao PMM ao mapear a heap */
+#ifndef KHEAP_FRAME_BATCH
+#define KHEAP_FRAME_BATCH 64u
+#endif
+
+/* Trechos da heap alinhados à página grande (4 MiB; 2 MiB no PAE) são
+ * mapeados com uma única PDE quando o PMM tem o bloco contíguo */
+#ifndef KHEAP_LARGE_PAGES
+#define KHEAP_LARGE_PAGES 1
+#endif
+
+/* Com o tratador de #PF armado, o crescimento da heap só registra uma
+ * região demand-zero; os frames vêm no primeiro acesso a cada página */
+#ifndef KHEAP_LAZY
+#define KHEAP_LAZY 1
+#endif
+
+/* Crescimento geométrico: cada expansão pega pelo menos o passo atual,
+ * que dobra a cada expansão de GROW_MIN até GROW_MAX */
+#ifndef KHEAP_GROW_MIN
+#define KHEAP_GROW_MIN (64u * 1024u)
+#endif
+
+#ifndef KHEAP_GROW_MAX
+#define KHEAP_GROW_MAX (4u * 1024u * 1024u)
+#endif
+
+/* Frames que a heap deixa livres no PMM: crescer além disso falha e o
+ * kmalloc devolve NULL */
+#ifndef KHEAP_PMM_RESERVE
+#define KHEAP_PMM_RESERVE 256u
+#endif
+
+/* Alocador: 1 = TLSF (listas livres segregadas em dois níveis, boundary
+ * tags, alocar/liberar O(1)); 0 = varredura first-fit do bitmap de
+ * unidades do diagrama acima, mantida para comparação (kheap_bench.c) */
+#ifndef KHEAP_TLSF
+#define KHEAP_TLSF 1
+#endif
+
+/* Região que o memory_setup entrega ao kheap_init. Com TLSF é a janela
+ * inteira: só o VA fica reservado e o mapeamento acompanha o uso. O
+ * bitmap reserva metadados para a região toda, então fica em 1 MiB. */
+#ifndef KHEAP_REGION_SIZE
+#if KHEAP_TLSF
+#define KHEAP_REGION_SIZE KHEAP_WINDOW_SIZE
+#else
+#define KHEAP_REGION_SIZE (1024u * 1024u)
+#endif
+#endif
+
+/* Pedidos de KHEAP_LARGE_MIN bytes ou mais (alinhados até uma página)
+ * vão direto para o vmalloc: frames avulsos, página de guarda, e o kfree
+ * desmapeia e devolve os frames na hora. Sem VA ou slots no vmalloc,
+ * caem no alocador da heap. */
+#ifndef KHEAP_LARGE
+#define KHEAP_LARGE 1
+#endif
+
+#ifndef KHEAP_LARGE_MIN
+#define KHEAP_LARGE_MIN PAGE_SIZE
+#endif
+
+/* TLSF: cada potência de 2 é dividida em 2^KHEAP_TLSF_SL_LOG2 listas;
+ * blocos vão até 2^KHEAP_TLSF_FL_MAX bytes */
+#ifndef KHEAP_TLSF_SL_LOG2
+#define KHEAP_TLSF_SL_LOG2 4u
+#endif
+
+#ifndef KHEAP_TLSF_FL_MAX
+#define KHEAP_TLSF_FL_MAX 28u
+#endif
+
+/* Devolução de páginas livres ao PMM (só com TLSF e o tratador de #PF,
+ * que as remapeia sob demanda). Começa quando os bytes livres ainda
+ * mapeados passam de HIGH e para ao chegar em LOW; blocos livres com
+ * menos de MIN_PAGES páginas inteiras ficam como estão. */
+#ifndef KHEAP_SHRINK
+#define KHEAP_SHRINK 1
+#endif
+
+#ifndef KHEAP_SHRINK_HIGH
+#define KHEAP_SHRINK_HIGH (256u * 1024u)
+#endif
+
+#ifndef KHEAP_SHRINK_LOW
+#define KHEAP_SHRINK_LOW  (128u * 1024u)
+#endif
+
+#ifndef KHEAP_SHRINK_MIN_PAGES
+#define KHEAP_SHRINK_MIN_PAGES 4u
+#endif
+
 #define HEAP_WORD_INDEX(unit_idx)   ((unit_idx) / 32u)
 #define HEAP_BIT_OFFSET(unit_idx)   ((unit_idx) % 32u)
 
@@ -93,6 +196,11 @@ void* kpage_alloc(void);
 /* se quiser um bloco de N páginas alinhado em página */
 void* kpages_alloc(size_t num_pages);
 
+#ifdef KHEAP_BENCH
+/* Latência média e pior de kmalloc/kfree em cargas mistas (kheap_bench.c) */
+void kheap_bench(void);
+#endif
+
 /* ----------------------------------------------------
  * Estatísticas da heap
  * -------------------------------------------------- */
@@ -103,6 +211,31 @@ size_t kheap_get_free_units(void);
 /* Retorna o número total de unidades atualmente mapeadas/úteis */
 size_t kheap_get_total_units(void);
 
+typedef struct {
+    size_t size;            // área de dados atual (bytes)
+    size_t free;            // bytes livres nos blocos
+    size_t largest_free;    // maior bloco livre (bytes)
+    size_t resident;        // bytes da área com frame mapeado
+    size_t released;        // páginas livres hoje sem frame
+    size_t pages_returned;  // frames devolvidos ao PMM (acumulado)
+    size_t shrinks;         // passadas de devolução
+    size_t blocks;          // blocos em uso
+    size_t meta;            // bytes de metadados do alocador
+    size_t meta_bitmap;     // o que o layout bitmap reservaria para 'size'
+    size_t large;           // blocos grandes (vmalloc) vivos
+    size_t large_pages;     // páginas desses blocos
+} kheap_stats_t;
+
+void kheap_get_stats(kheap_stats_t* out);
+
+/* Chamado pelo #PF quando uma página da heap ganha frame próprio
+ * (demand-zero preenchida ou página zero quebrada numa escrita) */
+void kheap_page_faulted_in(void);
+void kheap_print_stats(void);
+
+/* Uma linha com os metadados da heap naquele ponto ('label' = carga) */
+void kheap_print_meta(const char* label);
+
 /* ----------------------------------------------------
  * Funções de debug (dump)
  * -------------------------------------------------- */
@@ -0,0 +1,163 @@
+/* kheap_bench.c - Medição de latência da kheap
+ *
+ * Compilado apenas com -DKHEAP_BENCH. memory_setup() chama kheap_bench()
+ * logo depois do kheap_init(). A sequência de pedidos é fixa (semente
+ * constante): para comparar os alocadores, rode uma vez com KHEAP_TLSF=1
+ * e outra com KHEAP_TLSF=0; para o caminho de blocos grandes, compare
+ * KHEAP_LARGE=1 com KHEAP_LARGE=0.
+ */
+
+#include "kheap.h"
+#include "../klib/kprintf.h"
+#include "../cpu/cpu.h"
+
+#ifdef KHEAP_BENCH
+
+/* Ponteiros vivos ao mesmo tempo e operações por distribuição */
+#ifndef KHEAP_BENCH_SLOTS
+#define KHEAP_BENCH_SLOTS 128u
+#endif
+
+#ifndef KHEAP_BENCH_OPS
+#define KHEAP_BENCH_OPS   20000u
+#endif
+
+typedef enum {
+    BENCH_SMALL = 0,    // 8-256 B
+    BENCH_MIXED,        // 80% 8-256 B, 20% 256 B-4 KiB
+    BENCH_PAGES,        // 70% 16-512 B, 30% kpage_alloc/kpages_alloc(2)
+    BENCH_LARGE,        // 75% 16-512 B, 25% 4-32 KiB
+    BENCH_DIST_COUNT
+} bench_dist_t;
+
+static const char* const g_dist_names[BENCH_DIST_COUNT] = {
+    "pequenos (8-256 B)", "misto (ate 4 KiB)", "com paginas alinhadas",
+    "com blocos grandes (ate 32 KiB)"
+};
+
+typedef struct {
+    uint64_t sum;
+    uint32_t max;
+    uint32_t count;
+} bench_lat_t;
+
+static void*    g_bench_ptrs[KHEAP_BENCH_SLOTS];
+static uint32_t g_bench_rng;
+
+static uint32_t bench_rand(void)
+{
+    uint32_t x = g_bench_rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return g_bench_rng = x;
+}
+
+static uint32_t bench_range(uint32_t lo, uint32_t hi)
+{
+    return lo + bench_rand() % (hi - lo + 1u);
+}
+
+static void bench_record(bench_lat_t* lat, uint64_t cycles)
+{
+    uint32_t c32 = (cycles >> 32) ? 0xFFFFFFFFu : (uint32_t)cycles;
+    lat->sum += c32;
+    lat->count++;
+    if (c32 > lat->max) lat->max = c32;
+}
+
+/* Média sem divisão de 64 bits (evita a libgcc) */
+static uint32_t bench_mean(const bench_lat_t* lat)
+{
+    uint64_t sum = lat->sum;
+    uint32_t n   = lat->count;
+    while (sum >> 32) {
+        sum >>= 1;
+        n   >>= 1;
+    }
+    return n ? (uint32_t)sum / n : 0u;
+}
+
+static void* bench_alloc(bench_dist_t dist)
+{
+    uint32_t r = bench_rand() % 10u;
+
+    switch (dist) {
+        case BENCH_MIXED:
+            if (r < 8u) return kmalloc(bench_range(8, 256));
+            return kmalloc(bench_range(257, 4096));
+        case BENCH_PAGES:
+            if (r < 7u) return kmalloc(bench_range(16, 512));
+            return (r == 9u) ? kpages_alloc(2) : kpage_alloc();
+        case BENCH_LARGE:
+            if ((bench_rand() & 3u) != 0u) return kmalloc(bench_range(16, 512));
+            return kmalloc(bench_range(4096, 32768));
+        case BENCH_SMALL:
+        default:
+            return kmalloc(bench_range(8, 256));
+    }
+}
+
+static void bench_run(bench_dist_t dist)
+{
+    bench_lat_t a = {0}, f = {0};
+    uint32_t    failed = 0;
+
+    for (uint32_t op = 0; op < KHEAP_BENCH_OPS; ++op) {
+        uint32_t slot = bench_rand() % KHEAP_BENCH_SLOTS;
+
+        if (g_bench_ptrs[slot]) {
+            uint64_t t0 = cpu_rdtsc();
+            kfree(g_bench_ptrs[slot]);
+            bench_record(&f, cpu_rdtsc() - t0);
+            g_bench_ptrs[slot] = NULL;
+            continue;
+        }
+
+        uint64_t t0 = cpu_rdtsc();
+        void*    p  = bench_alloc(dist);
+        bench_record(&a, cpu_rdtsc() - t0);
+
+        if (!p) failed++;
+        g_bench_ptrs[slot] = p;
+    }
+
+    // fragmentação com os blocos ainda vivos: quanto do livre não está
+    // no maior bloco
+    kheap_stats_t st;
+    kheap_get_stats(&st);
+    unsigned frag = st.free ? (unsigned)(100u - st.largest_free / (st.free / 100u + 1u)) : 0u;
+
+    for (uint32_t i = 0; i < KHEAP_BENCH_SLOTS; ++i) {
+        kfree(g_bench_ptrs[i]);
+        g_bench_ptrs[i] = NULL;
+    }
+
+    kprintf("\n  %s: alloc media %u max %u | free media %u max %u ciclos, %u falhas",
+            g_dist_names[dist], (unsigned)bench_mean(&a), (unsigned)a.max,
+            (unsigned)bench_mean(&f), (unsigned)f.max, (unsigned)failed);
+    kprintf("\n    heap %u KiB, %u KiB livres, maior livre %u KiB (%u%% fragmentado),"
+            " %u paginas em blocos grandes",
+            (unsigned)(st.size >> 10), (unsigned)(st.free >> 10),
+            (unsigned)(st.largest_free >> 10), frag, (unsigned)st.large_pages);
+}
+
+/**
+ * Alterna alocações e liberações aleatórias sobre KHEAP_BENCH_SLOTS
+ * ponteiros, com três distribuições de tamanho, e imprime a latência
+ * média e a pior de kmalloc/kpage_alloc e de kfree.
+ */
+void kheap_bench(void)
+{
+    kprintf("\nkheap bench (%s%s): %u operacoes por distribuicao, %u slots",
+            KHEAP_TLSF ? "TLSF" : "bitmap first-fit",
+            KHEAP_LARGE ? " + blocos grandes no vmalloc" : "",
+            (unsigned)KHEAP_BENCH_OPS, (unsigned)KHEAP_BENCH_SLOTS);
+
+    for (uint32_t d = 0; d < BENCH_DIST_COUNT; ++d) {
+        g_bench_rng = 0x2545F491u + d;
+        bench_run((bench_dist_t)d);
+    }
+}
+
+#endif /* KHEAP_BENCH */
@@ -3,9 +3,13 @@
 #include "../mm/bootmem.h"
 #include "../mm/pmm.h"
 #include "../mm/kheap.h"
+#include "../mm/vmalloc.h"
 #include "./page/paging.h"
+#include "./page/paging_kmap.h"
+#include "./page/ioremap.h"
 #include "./../idt/idt.h"
 #include "../cpu/cpu.h"
+#include "../klib/panic.h"
 
 void memory_setup(e820_address_t *e820_address) {
    
@@ -18,8 +22,17 @@ void memory_setup(e820_address_t *e820_address) {
     uintptr_t k_phys_start = (uintptr_t)get_kernel_ini_phys();
     uintptr_t k_phys_end   = (uintptr_t)get_kernel_end_phys();
 
-    uint64_t memory_size=get_memory_size();
-     kprintf("\n\n(*)memory_size = %u",memory_size );    
+    /* PAE: decide o modo de paging antes do PMM. O PMM precisa enxergar
+       até a última região USABLE (que pode estar acima de 4 GiB); sem
+       PAE, o que passa de 4 GiB não é endereçável.
+    */
+    bool pae = paging_pae_probe();
+
+    uint64_t memory_size = e820_memory_top();
+    if (!pae && memory_size > PMM_ZONE_NORMAL_LIMIT) memory_size = PMM_ZONE_NORMAL_LIMIT;
+    if (memory_size > MAX_PHYS_MEM) memory_size = MAX_PHYS_MEM;
+    kprintf("\n\n(*)memory_size = %u MiB (PAE %s)",
+            (unsigned)(memory_size >> 20), pae ? "ligado" : "desligado");
            
     /*
     ALOCADOR BOOT EARLY - É o alocador utilizado antes de concluirmos a
@@ -29,36 +42,53 @@ void memory_setup(e820_address_t *e820_address) {
     o boot_early NÃO PODE SER USADO para alocações de memória.
     */
 
-    size_t boot_early_size = 4 * MB_SIZE;   // ou 16MiB
+    /* Além das estruturas iniciais, o boot_early guarda o vetor de page_t
+       (8 bytes por frame: 8 MiB para 4 GiB).
+    */
+    size_t pages_size      = pmm_calc_pages_size_bytes(memory_size);
+    size_t boot_early_size = 4 * MB_SIZE + ALIGN_UP(pages_size, PAGE_SIZE);
     boot_early_init(k_phys_end, boot_early_size);
 
 
     /* BITMAP: Criando o BITMAP para gerenciar o uso da memória física.
     */
    
-    size_t bitmap_size=pmm_calc_bitmap_size_bytes(memory_size);
+    size_t bitmap_size=pmm_calc_meta_size_bytes(memory_size);
     kprintf("\nTamanho do bitmap = %u bytes",bitmap_size );
    
     uint32_t *pmm_bitmap = (uint32_t*)boot_early_kalloc(bitmap_size, 4096);
     kprintf("\nEndereco virtual do bitmap = %p",pmm_bitmap );      
       
-    /* Inicializa o bitmap  */
+    /* Inicializa o bitmap (medido em ciclos; compare com PMM_INIT_BITWISE=1) */
+    uint64_t t0 = cpu_rdtsc();
     pmm_init(pmm_bitmap,memory_size);
+    uint64_t pmm_cycles = cpu_rdtsc() - t0;
+    kprintf("\npmm_init: %u Kciclos (1K = 1024)%s", (unsigned)(pmm_cycles >> 10),
+            PMM_INIT_BITWISE ? " [bit a bit]" : "");
    
     /* PAGGING: Inicia o pagging */       
     
     paging_ctx_t *ctx=get_paging_ctx();
     ctx->alloc_page_aligned = early_alloc_wrapper,  //função que será usada para alocar memória        
         ctx->virt_to_phys       = virt_to_phys_kernel, // identity no bootstrap
-        ctx->bootstrap_identity_limit = 64u * 1024u * 1024u, // 64MiB
+        ctx->bootstrap_identity_limit = (uintptr_t)PMM_ZONE_IDENTITY_LIMIT, // 64MiB
         ctx->kernel_virt_base   = 0xC0000000u,
         ctx->kernel_phys_start  = k_phys_start,
         ctx->kernel_phys_end    = k_phys_end,
         ctx->kernel_page_flags  = PAGE_RW,
+        ctx->physmap_size       = (uintptr_t)((memory_size < PHYSMAP_MAX_SIZE) ? memory_size : PHYSMAP_MAX_SIZE),
      
     paging_init_minimal(ctx);
     debug_early_init();
 
+    /* PAGE_T: descritores por frame. Alocados só agora porque o vetor
+       passa dos 4 MiB mapeados pelo boot e precisa da janela identity.
+    */
+    page_t *pmm_pages = (page_t*)boot_early_kalloc(pages_size, 4096);
+    if (!pmm_pages) panic("memory_setup: sem espaco para page_t");
+    pmm_pages_init(pmm_pages);
+    kprintf("\nVetor page_t = %p (%u bytes)", pmm_pages, (unsigned)pages_size);
+
      /**
      * Precisamos marcar a área do kernel e das estruturas criadas como utilizadas
      * no bitmap para evitar que sejam requisitadas e sobrepostas.
@@ -66,10 +96,25 @@ void memory_setup(e820_address_t *e820_address) {
     uintptr_t boot_early_end   = boot_early_phys_end();    
     pmm_mark_region_used64(k_phys_start, boot_early_end - k_phys_start);//Sem isso gera erro
 
+#if PAGING_KERNEL_PREALLOC
+    /* PTs do high-half inteiro, compartilhadas por todos os diretórios
+       (antes da heap, que já mapeia no high-half). Com páginas grandes na
+       heap a janela dela fica sem PTs: PDE com PT não aceita página grande */
+    uintptr_t prealloc_skip_start = 0;
+    uintptr_t prealloc_skip_end   = 0;
+#if KHEAP_LARGE_PAGES
+    if (paging_large_enabled()) {
+        prealloc_skip_start = KHEAP_BASE;
+        prealloc_skip_end   = KHEAP_BASE + KHEAP_WINDOW_SIZE;
+    }
+#endif
+    paging_prealloc_kernel_tables(ctx, prealloc_skip_start, prealloc_skip_end);
+#endif
+
       
     /* KHEAP: Inicializa a kheap     */
 
-    size_t    heap_region_size  = MB_SIZE *1; // ex: alguns MiB
+    size_t    heap_region_size  = KHEAP_REGION_SIZE;  // janela; mapeada conforme o uso
     size_t    heap_initial_size = MB_SIZE *1;         // ex: 1 MiB inicial
     uintptr_t heap_region_start = (uintptr_t)KHEAP_BASE; 
    
@@ -80,6 +125,27 @@ void memory_setup(e820_address_t *e820_address) {
            (uint32_t)heap_region_size,
            (uint32_t)heap_initial_size);
 
+    pmm_print_stats();
+    paging_print_stats();
+
+    /* IOREMAP: PAT e janela de MMIO */
+    ioremap_init();
+
+    /* VMALLOC: buffers grandes, contíguos só no VA */
+    vmalloc_init();
+
+#ifdef PMM_COLOR_BENCH
+    pmm_color_bench();
+#endif
+
+#ifdef IOREMAP_BENCH
+    ioremap_bench();
+#endif
+
+#ifdef KHEAP_BENCH
+    kheap_bench();
+#endif
+
     
      
 }
\ No newline at end of file
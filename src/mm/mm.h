@@ -42,6 +42,38 @@
 #define PAGE_SIZE 4096u
 #endif
 
+/* Endereço físico. Com PAE a memória física passa de 4 GiB, então
+ * frames e entradas de tabela usam 64 bits mesmo com ponteiros de 32. */
+typedef uint64_t phys_addr_t;
+
+/* Suporte a PAE compilado no kernel. O modo só é ativado no boot se a
+ * CPU anunciar PAE no CPUID; senão o paging clássico de 32 bits é usado. */
+#ifndef PAGING_PAE
+#define PAGING_PAE 1
+#endif
+
+/* Páginas grandes (PDE com PS = 1): 4 MiB com PSE no modo de 32 bits,
+ * 2 MiB no PAE. Usadas onde VA e PA estão alinhados ao tamanho da página. */
+#ifndef PAGING_PSE
+#define PAGING_PSE 1
+#endif
+
+/* Mapeamentos globais (CR4.PGE): as traduções do high-half sobrevivem à
+ * troca de CR3 entre espaços de endereçamento. */
+#ifndef PAGING_PGE
+#define PAGING_PGE 1
+#endif
+
+/* Todas as PTs do high-half alocadas no boot e compartilhadas por
+ * referência: mapeamentos novos do kernel aparecem em todo diretório
+ * sem sincronizar PDEs. Custa 1 MiB fixo (2 MiB no PAE) menos o que já
+ * estiver mapeado por PDEs grandes. Com KHEAP_LARGE_PAGES a janela da
+ * heap fica de fora (suas PDEs recebem páginas grandes). Com 0, ou
+ * nessa janela, as PDEs chegam aos outros diretórios pelo tratador de #PF. */
+#ifndef PAGING_KERNEL_PREALLOC
+#define PAGING_KERNEL_PREALLOC 1
+#endif
+
 
 static inline bool is_power_of_two(uintptr_t x)
 {
@@ -0,0 +1,170 @@
+/* ioremap.c - Mapeamento de memória de dispositivo (MMIO)
+ *
+ * Os mapeamentos vivem numa janela fixa do high-half, no kernel_directory
+ * (cujas PTs são compartilhadas por todos os diretórios). O tipo de
+ * memória vem dos bits PWT/PCD/PAT da PTE, interpretados pelo IA32_PAT.
+ */
+
+#include "ioremap.h"
+#include "../mm.h"
+#include "../../cpu/cpu.h"
+#include "../../cpu/e820.h"
+#include "../../klib/kprintf.h"
+
+/* Códigos de tipo do PAT */
+#define PAT_UC      0x00u
+#define PAT_WC      0x01u
+#define PAT_WT      0x04u
+#define PAT_WB      0x06u
+#define PAT_UC_MINUS 0x07u
+
+#define PAT_ENTRY(idx, type) ((uint64_t)(type) << ((idx) * 8u))
+
+/* 0-3 como no reset (WB, WT, UC-, UC); 4 WB, 5 WC, 6 UC-, 7 UC */
+#define PAT_LAYOUT (PAT_ENTRY(0, PAT_WB) | PAT_ENTRY(1, PAT_WT) |       \
+                    PAT_ENTRY(2, PAT_UC_MINUS) | PAT_ENTRY(3, PAT_UC) | \
+                    PAT_ENTRY(4, PAT_WB) | PAT_ENTRY(5, PAT_WC) |       \
+                    PAT_ENTRY(6, PAT_UC_MINUS) | PAT_ENTRY(7, PAT_UC))
+
+typedef struct ioremap_area {
+    uintptr_t va;       /* 0 = slot livre          */
+    size_t    pages;
+} ioremap_area_t;
+
+static ioremap_area_t g_ioremap[IOREMAP_MAX];
+static bool           g_pat_enabled = false;
+
+bool ioremap_pat_enabled(void)
+{
+    return g_pat_enabled;
+}
+
+/**
+ * Troca o IA32_PAT com as caches desligadas (CR0.CD) e esvaziadas antes e
+ * depois, como pede o manual da Intel para mudanças de tipo de memória.
+ */
+static void pat_program(void)
+{
+    uint32_t irq = cpu_irq_save();
+    uint32_t cr0 = cpu_read_cr0();
+
+    cpu_write_cr0((cr0 | (1u << CR0_CD_BIT)) & ~(1u << CR0_NW_BIT));
+    cpu_wbinvd();
+    paging_flush_tlb_global();
+
+    cpu_wrmsr(MSR_IA32_PAT, PAT_LAYOUT);
+
+    cpu_wbinvd();
+    paging_flush_tlb_global();
+    cpu_write_cr0(cr0);
+
+    cpu_irq_restore(irq);
+}
+
+void ioremap_init(void)
+{
+    if (cpu_has_feature_edx(CPUID1_EDX_PAT_BIT) && cpu_has_feature_edx(CPUID1_EDX_MSR_BIT)) {
+        pat_program();
+        g_pat_enabled = true;
+    }
+
+    kprintf("\nioremap: janela %p - %p, PAT %s", (void*)IOREMAP_BASE,
+            (void*)(IOREMAP_BASE + IOREMAP_SIZE - 1u),
+            g_pat_enabled ? "programado (WC disponivel)" : "ausente (WC vira UC)");
+}
+
+uint32_t ioremap_cache_flags(ioremap_type_t type)
+{
+    switch (type) {
+        case IOREMAP_WB: return 0;                                  // PAT 0
+        case IOREMAP_WT: return PAGE_WRITETHRU;                     // PAT 1
+        case IOREMAP_WC:
+            if (g_pat_enabled) return PAGE_PAT | PAGE_WRITETHRU;    // PAT 5
+            return PAGE_NOCACHE | PAGE_WRITETHRU;
+        case IOREMAP_UC:
+        default:         return PAGE_NOCACHE | PAGE_WRITETHRU;      // PAT 3
+    }
+}
+
+/* true se [base, end) toca alguma região USABLE do E820 */
+static bool overlaps_usable_ram(uint64_t base, uint64_t end)
+{
+    size_t n = e820_regions_count();
+
+    for (size_t i = 0; i < n; ++i) {
+        phys_region_t* r = e820_region_by_index(i);
+        if (!r || r->type != E820_TYPE_USABLE) continue;
+        if (base < r->base + r->length && r->base < end) return true;
+    }
+    return false;
+}
+
+/* Primeiro trecho livre de 'pages' páginas na janela (0 se não houver) */
+static uintptr_t ioremap_find_va(size_t pages)
+{
+    uintptr_t size = (uintptr_t)pages * PAGE_SIZE;
+    uintptr_t va   = IOREMAP_BASE;
+
+    for (uint32_t i = 0; i < IOREMAP_MAX; ) {
+        if (va + size > IOREMAP_BASE + IOREMAP_SIZE || va + size < va) return 0;
+
+        const ioremap_area_t* a = &g_ioremap[i];
+        uintptr_t a_end = a->va + (uintptr_t)a->pages * PAGE_SIZE;
+        if (a->va && va < a_end && a->va < va + size) {
+            va = a_end;     // pula a área ocupada e revisa desde o início
+            i  = 0;
+            continue;
+        }
+        ++i;
+    }
+    return va;
+}
+
+void* ioremap(phys_addr_t phys, size_t size, ioremap_type_t type)
+{
+    if (size == 0) return NULL;
+
+    phys_addr_t base  = phys & ~(phys_addr_t)(PAGE_SIZE - 1);
+    uint32_t    off   = (uint32_t)(phys - base);
+    size_t      pages = (size_t)ALIGN_UP((uintptr_t)off + size, PAGE_SIZE) / PAGE_SIZE;
+
+    if (overlaps_usable_ram(base, base + (phys_addr_t)pages * PAGE_SIZE)) {
+        kprintf("\nioremap: %p (+%u) sobrepoe RAM utilizavel", (void*)(uintptr_t)phys,
+                (unsigned)size);
+        return NULL;
+    }
+
+    ioremap_area_t* slot = NULL;
+    for (uint32_t i = 0; i < IOREMAP_MAX && !slot; ++i) {
+        if (!g_ioremap[i].va) slot = &g_ioremap[i];
+    }
+    if (!slot) return NULL;
+
+    uintptr_t va = ioremap_find_va(pages);
+    if (!va) return NULL;
+
+    uint32_t flags = PAGE_RW | ioremap_cache_flags(type) | paging_kernel_global();
+    if (paging_map_range_contig(kernel_directory, get_paging_ctx(), va, base, pages, flags) != 0) {
+        return NULL;
+    }
+
+    slot->va    = va;
+    slot->pages = pages;
+    return (void*)(va + off);
+}
+
+void iounmap(void* addr)
+{
+    uintptr_t va = (uintptr_t)addr & ~(uintptr_t)(PAGE_SIZE - 1);
+
+    for (uint32_t i = 0; i < IOREMAP_MAX; ++i) {
+        ioremap_area_t* a = &g_ioremap[i];
+        if (a->va != va) continue;
+
+        paging_unmap_range(kernel_directory, get_paging_ctx(), va, a->pages);
+        a->va    = 0;
+        a->pages = 0;
+        return;
+    }
+    kprintf("\niounmap: %p nao foi mapeado por ioremap", addr);
+}
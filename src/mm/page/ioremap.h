@@ -0,0 +1,59 @@
+#ifndef IOREMAP_H
+#define IOREMAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "paging.h"
+#include "paging_kmap.h"
+
+/* Janela de VA do kernel para MMIO, logo depois do physmap */
+#ifndef IOREMAP_BASE
+#define IOREMAP_BASE 0xE8000000u
+#endif
+
+#ifndef IOREMAP_SIZE
+#define IOREMAP_SIZE 0x07000000u   /* 112 MiB */
+#endif
+
+/* Mapeamentos simultâneos */
+#ifndef IOREMAP_MAX
+#define IOREMAP_MAX  32u
+#endif
+
+_Static_assert(IOREMAP_BASE >= PHYSMAP_BASE + PHYSMAP_MAX_SIZE,
+               "janela de ioremap sobrepoe o physmap");
+
+/* Tipo de memória do mapeamento. Sem PAT, WC vira UC. */
+typedef enum ioremap_type {
+    IOREMAP_WB = 0,     /* write-back (cache normal)                  */
+    IOREMAP_WT,         /* write-through                              */
+    IOREMAP_UC,         /* sem cache (registradores de dispositivo)   */
+    IOREMAP_WC,         /* write-combining (framebuffers, escrita em bloco) */
+} ioremap_type_t;
+
+/* Programa o IA32_PAT (se a CPU tiver PAT). As entradas 0-3 ficam com o
+ * valor de reset, então PWT/PCD mantêm o sentido de sempre; a entrada 5
+ * (PAT + PWT) passa a ser WC. */
+void ioremap_init(void);
+
+/* PAT programado: IOREMAP_WC é write-combining de verdade */
+bool ioremap_pat_enabled(void);
+
+/* Bits de PTE (PWT/PCD/PAT) que selecionam o tipo de memória */
+uint32_t ioremap_cache_flags(ioremap_type_t type);
+
+/* Mapeia [phys, phys + size) na janela de MMIO com o tipo indicado e
+ * devolve o endereço virtual (com o mesmo deslocamento na página).
+ * NULL se o intervalo tocar RAM utilizável do E820 ou faltar espaço. */
+void* ioremap(phys_addr_t phys, size_t size, ioremap_type_t type);
+
+/* Desfaz um mapeamento devolvido por ioremap() */
+void iounmap(void* addr);
+
+#ifdef IOREMAP_BENCH
+/* Compara escrita em bloco WC x UC no framebuffer VGA (ioremap_bench.c) */
+void ioremap_bench(void);
+#endif
+
+#endif
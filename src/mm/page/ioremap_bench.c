@@ -0,0 +1,106 @@
+/* ioremap_bench.c - Medição de boot do ioremap
+ *
+ * Compilado apenas com -DIOREMAP_BENCH. memory_setup() chama
+ * ioremap_bench() depois do ioremap_init().
+ */
+
+#include "ioremap.h"
+#include "../../io/io.h"
+#include "../../cpu/cpu.h"
+#include "../../klib/kprintf.h"
+
+#ifdef IOREMAP_BENCH
+
+/* Bytes escritos por passada e quantas passadas medir */
+#ifndef IOREMAP_BENCH_SIZE
+#define IOREMAP_BENCH_SIZE   (1024u * 1024u)
+#endif
+
+#define IOREMAP_BENCH_PASSES 4u
+
+/* VGA "std" do QEMU (-vga std): PCI 1234:1111, framebuffer no BAR0 */
+#define BENCH_VGA_VENDOR     0x1234u
+#define BENCH_VGA_DEVICE     0x1111u
+#define BENCH_VGA_FB_DEFAULT 0xFD000000u
+
+#define PCI_CONFIG_ADDRESS   0xCF8u
+#define PCI_CONFIG_DATA      0xCFCu
+
+static uint32_t pci_read32(uint32_t bus, uint32_t dev, uint32_t fn, uint32_t reg)
+{
+    __write_portd(PCI_CONFIG_ADDRESS,
+                  0x80000000u | (bus << 16) | (dev << 11) | (fn << 8) | (reg & 0xFCu));
+    return __read_portd(PCI_CONFIG_DATA);
+}
+
+/* Procura o VGA do QEMU no barramento 0; senão, usa o endereço padrão */
+static phys_addr_t bench_find_framebuffer(void)
+{
+    for (uint32_t dev = 0; dev < 32u; ++dev) {
+        uint32_t id = pci_read32(0, dev, 0, 0x00);
+        if ((id & 0xFFFFu) == BENCH_VGA_VENDOR && (id >> 16) == BENCH_VGA_DEVICE) {
+            return (phys_addr_t)(pci_read32(0, dev, 0, 0x10) & ~0xFu);
+        }
+    }
+    return BENCH_VGA_FB_DEFAULT;
+}
+
+/* Escreve o buffer inteiro PASSES vezes e devolve os ciclos. O cpuid no
+ * fim serializa e esvazia os buffers de WC antes da leitura do TSC. */
+static uint64_t bench_stream(phys_addr_t fb, ioremap_type_t type)
+{
+    volatile uint32_t* p = (volatile uint32_t*)ioremap(fb, IOREMAP_BENCH_SIZE, type);
+    if (!p) return 0;
+
+    size_t words = IOREMAP_BENCH_SIZE / sizeof(uint32_t);
+
+    uint64_t t0 = cpu_rdtsc();
+    for (unsigned pass = 0; pass < IOREMAP_BENCH_PASSES; ++pass) {
+        for (size_t i = 0; i < words; ++i) p[i] = (uint32_t)(i ^ pass);
+    }
+    cpu_cpuid(0, NULL, NULL, NULL, NULL);
+    uint64_t cycles = cpu_rdtsc() - t0;
+
+    iounmap((void*)p);
+    return cycles;
+}
+
+static void bench_report(const char* label, uint64_t cycles)
+{
+    uint32_t kib = (IOREMAP_BENCH_SIZE / 1024u) * IOREMAP_BENCH_PASSES;
+    uint32_t c32 = (cycles >> 32) ? 0xFFFFFFFFu : (uint32_t)cycles;
+
+    kprintf("\n  %s: %u Kciclos, %u ciclos/KiB", label,
+            (unsigned)(c32 >> 10), (unsigned)(c32 / kib));
+}
+
+/**
+ * Escreve IOREMAP_BENCH_SIZE bytes no framebuffer mapeado como UC e
+ * depois como WC. Sem PAT os dois mapeamentos são UC.
+ */
+void ioremap_bench(void)
+{
+    phys_addr_t fb = bench_find_framebuffer();
+
+    kprintf("\nioremap bench: framebuffer %p, %u KiB x %u passadas",
+            (void*)(uintptr_t)fb, (unsigned)(IOREMAP_BENCH_SIZE / 1024u),
+            (unsigned)IOREMAP_BENCH_PASSES);
+
+    uint64_t uc = bench_stream(fb, IOREMAP_UC);
+    uint64_t wc = bench_stream(fb, IOREMAP_WC);
+    if (!uc || !wc) {
+        kprintf("\n  falha ao mapear o framebuffer");
+        return;
+    }
+
+    bench_report("UC", uc);
+    bench_report("WC", wc);
+
+    uint32_t wc32 = (wc >> 32) ? 0xFFFFFFFFu : (uint32_t)wc;
+    uint32_t uc32 = (uc >> 32) ? 0xFFFFFFFFu : (uint32_t)uc;
+    if (wc32 >> 10) {
+        kprintf("\n  WC/UC: %ux mais rapido", (unsigned)((uc32 >> 10) / (wc32 >> 10)));
+    }
+}
+
+#endif /* IOREMAP_BENCH */
@@ -0,0 +1,367 @@
+/* page_fault.c - Tratador de #PF e regiões sob demanda
+ *
+ * Uma região demand-zero só existe na tabela de regiões até ser tocada:
+ *  - leitura em página ausente  -> mapeia a página zero compartilhada,
+ *                                  só leitura (uma referência a mais);
+ *  - escrita em página ausente  -> frame zerado próprio, RW;
+ *  - escrita na página zero     -> troca por frame zerado próprio.
+ *
+ * O high-half tem uma lista de regiões única (mapeada no kernel_directory
+ * e levada aos outros diretórios copiando a PDE); cada diretório de
+ * usuário tem a sua. Falta fora de região termina em panic.
+ */
+
+#include "page_fault.h"
+#include "paging_kmap.h"
+#include "../mm.h"
+#include "../vmalloc.h"
+#include "../kheap.h"
+#include "../../klib/kprintf.h"
+#include "../../klib/panic.h"
+#include "../../cpu/cpu.h"
+
+typedef struct vm_space {
+    page_directory_t *dir;                  // NULL = slot livre
+    uint32_t          count;
+    vm_region_t       regions[VM_REGION_MAX];
+} vm_space_t;
+
+static vm_space_t g_kernel_space;
+static vm_space_t g_user_spaces[VM_SPACE_MAX];
+
+static phys_addr_t g_zero_frame = 0;
+static bool        g_pf_ready   = false;
+
+static page_fault_stats_t g_pf_stats;
+
+static inline bool va_is_kernel(uintptr_t va)
+{
+    return va >= KERNEL_VIRT_BASE;
+}
+
+/* Espaço dono de 'va' em 'dir'. Cria o do diretório se 'create'. */
+static vm_space_t *vm_space_for(page_directory_t *dir, uintptr_t va, bool create)
+{
+    if (va_is_kernel(va)) return &g_kernel_space;
+
+    if (!dir) dir = current_directory;
+    if (!dir) return NULL;
+
+    vm_space_t *free_slot = NULL;
+    for (uint32_t i = 0; i < VM_SPACE_MAX; ++i) {
+        if (g_user_spaces[i].dir == dir) return &g_user_spaces[i];
+        if (!g_user_spaces[i].dir && !free_slot) free_slot = &g_user_spaces[i];
+    }
+
+    if (!create || !free_slot) return NULL;
+    free_slot->dir   = dir;
+    free_slot->count = 0;
+    return free_slot;
+}
+
+static vm_region_t *vm_space_find(vm_space_t *space, uintptr_t va)
+{
+    for (uint32_t i = 0; i < space->count; ++i) {
+        vm_region_t *r = &space->regions[i];
+        if (va >= r->start && va < r->end) return r;
+    }
+    return NULL;
+}
+
+static void vm_space_delete(vm_space_t *space, uint32_t idx)
+{
+    space->regions[idx] = space->regions[--space->count];
+    if (space->count == 0 && space != &g_kernel_space) {
+        space->dir = NULL;
+    }
+}
+
+static inline bool vm_region_same(const vm_region_t *r, uint32_t flags, uint32_t type)
+{
+    return r->kind == VM_REGION_DEMAND_ZERO && r->flags == flags && r->type == type;
+}
+
+int vm_region_add(page_directory_t *dir, uintptr_t start, size_t size,
+                  uint32_t flags, page_type_t type)
+{
+    uintptr_t end = ALIGN_UP(start + size, PAGE_SIZE);
+    start = ALIGN_DOWN(start, PAGE_SIZE);
+    if (size == 0 || end <= start) return -1;
+
+    // uma região não atravessa a fronteira user/kernel
+    if (va_is_kernel(start) != va_is_kernel(end - 1)) return -1;
+
+    vm_space_t *space = vm_space_for(dir, start, true);
+    if (!space) return -1;
+
+    flags &= 0xFFFu & ~PAGE_PRESENT;
+
+    vm_region_t *before = NULL;
+    vm_region_t *after  = NULL;
+    for (uint32_t i = 0; i < space->count; ++i) {
+        vm_region_t *r = &space->regions[i];
+        if (start < r->end && r->start < end) return -1;   // sobreposição
+        if (r->end == start && vm_region_same(r, flags, type)) before = r;
+        if (r->start == end && vm_region_same(r, flags, type)) after = r;
+    }
+
+    if (before && after) {
+        before->end = after->end;
+        vm_space_delete(space, (uint32_t)(after - space->regions));
+        return 0;
+    }
+    if (before) { before->end = end;     return 0; }
+    if (after)  { after->start = start;  return 0; }
+
+    if (space->count >= VM_REGION_MAX) return -1;
+
+    vm_region_t *r = &space->regions[space->count++];
+    r->start = start;
+    r->end   = end;
+    r->flags = flags;
+    r->kind  = VM_REGION_DEMAND_ZERO;
+    r->type  = (uint16_t)type;
+    return 0;
+}
+
+int vm_region_clone(page_directory_t *src, page_directory_t *dst)
+{
+    vm_space_t *from = vm_space_for(src, 0, false);
+    if (!from || from->count == 0) return 0;
+
+    vm_space_t *to = vm_space_for(dst, 0, true);
+    if (!to) return -1;
+
+    for (uint32_t i = 0; i < from->count; ++i) {
+        to->regions[i] = from->regions[i];
+    }
+    to->count = from->count;
+    return 0;
+}
+
+const vm_region_t *vm_region_find(page_directory_t *dir, uintptr_t va)
+{
+    vm_space_t *space = vm_space_for(dir, va, false);
+    return space ? vm_space_find(space, va) : NULL;
+}
+
+int vm_region_remove(page_directory_t *dir, uintptr_t start, size_t size)
+{
+    uintptr_t end = ALIGN_UP(start + size, PAGE_SIZE);
+    start = ALIGN_DOWN(start, PAGE_SIZE);
+    if (size == 0 || end <= start) return -1;
+
+    vm_space_t *space = vm_space_for(dir, start, false);
+    if (!space) return -1;
+
+    vm_region_t *r = vm_space_find(space, start);
+    if (!r || end > r->end) return -1;
+
+    bool middle = (start > r->start && end < r->end);
+    if (middle && space->count >= VM_REGION_MAX) return -1;
+
+    page_directory_t *map_dir = va_is_kernel(start) ? kernel_directory : space->dir;
+    paging_unmap_release(map_dir, get_paging_ctx(), start, (size_t)((end - start) / PAGE_SIZE));
+
+    if (middle) {
+        vm_region_t *tail = &space->regions[space->count++];
+        *tail = *r;
+        tail->start = end;
+        r->end = start;
+    } else if (start == r->start && end == r->end) {
+        vm_space_delete(space, (uint32_t)(r - space->regions));
+    } else if (start == r->start) {
+        r->start = end;
+    } else {
+        r->end = start;
+    }
+    return 0;
+}
+
+void vm_space_release(page_directory_t *dir)
+{
+    if (!dir || dir == kernel_directory) return;
+
+    for (uint32_t i = 0; i < VM_SPACE_MAX; ++i) {
+        if (g_user_spaces[i].dir == dir) {
+            g_user_spaces[i].dir   = NULL;
+            g_user_spaces[i].count = 0;
+        }
+    }
+}
+
+phys_addr_t page_fault_zero_frame(void)
+{
+    return g_zero_frame;
+}
+
+/* Frame zerado próprio para 'page' (da cor do VA, se houver coloração) */
+static phys_addr_t pf_new_frame(const vm_region_t *r, uintptr_t page)
+{
+    phys_addr_t pa = pmm_alloc_zeroed_frame_for_va(page);
+    if (pa) page_set_type(pa, (page_type_t)r->type);
+    return pa;
+}
+
+/**
+ * Resolve a falta em 'va'. Devolve false se não há como (acesso fora de
+ * região, sem permissão ou sem memória).
+ */
+static bool pf_resolve(uintptr_t va, uint32_t err)
+{
+    if (!g_pf_ready || (err & PF_ERR_RSVD)) return false;
+
+    paging_ctx_t     *ctx    = get_paging_ctx();
+    page_directory_t *cur    = current_directory;
+    bool              kernel = va_is_kernel(va);
+
+    if (kernel && (err & PF_ERR_USER)) return false;
+
+    // PT do kernel criada depois do diretório atual: basta a PDE
+    if (kernel && !(err & PF_ERR_PRESENT) && paging_sync_kernel_pde(cur, va)) {
+        g_pf_stats.pde_syncs++;
+        return true;
+    }
+
+    // página compartilhada por um clone: copia só na escrita
+    if (!kernel && (err & (PF_ERR_PRESENT | PF_ERR_WRITE)) == (PF_ERR_PRESENT | PF_ERR_WRITE)) {
+        int cow = paging_cow_fault(cur, ctx, va, (err & PF_ERR_USER) != 0);
+        if (cow < 0) return false;
+        if (cow > 0) {
+            g_pf_stats.cow_faults++;
+            return true;
+        }
+    }
+
+    page_directory_t  *dir = kernel ? kernel_directory : cur;
+    const vm_region_t *r   = vm_region_find(dir, va);
+    if (!r) return false;
+
+    if ((err & PF_ERR_USER) && !(r->flags & PAGE_USER)) return false;
+    if ((err & PF_ERR_WRITE) && !(r->flags & PAGE_RW)) return false;
+
+    uintptr_t   page = va & ~(uintptr_t)(PAGE_SIZE - 1);
+    phys_addr_t old  = paging_get_physical(dir, ctx, page);
+    phys_addr_t pa;
+
+    if (old && old != g_zero_frame) {
+        // já tem frame próprio: outro caminho resolveu, só o TLB estava velho
+        invalid_tlb(page);
+        g_pf_stats.spurious++;
+        return true;
+    }
+
+    if (old) {
+        // página zero: só a escrita precisa de frame próprio
+        if (!(err & PF_ERR_WRITE)) {
+            invalid_tlb(page);
+            g_pf_stats.spurious++;
+            return true;
+        }
+        pa = pf_new_frame(r, page);
+        if (!pa || paging_map(dir, ctx, page, pa, r->flags) != 0) return false;
+        g_pf_stats.zero_breaks++;
+        if (kernel && r->type == PAGE_TYPE_HEAP) kheap_page_faulted_in();
+    } else if (!(err & PF_ERR_WRITE)) {
+        // sem page_get: a página zero não conta mapeamentos (PG_ZERO)
+        if (paging_map(dir, ctx, page, g_zero_frame, r->flags & ~PAGE_RW) != 0) return false;
+        g_pf_stats.zero_maps++;
+    } else {
+        pa = pf_new_frame(r, page);
+        if (!pa || paging_map(dir, ctx, page, pa, r->flags) != 0) return false;
+        g_pf_stats.zero_fills++;
+        if (kernel && r->type == PAGE_TYPE_HEAP) kheap_page_faulted_in();
+    }
+
+    // PT nova no kernel_directory: leva a PDE ao diretório atual
+    if (kernel && cur != kernel_directory) {
+        g_pf_stats.pde_syncs += (uint32_t)paging_sync_kernel_pde(cur, va);
+    }
+    return true;
+}
+
+bool page_fault_handle(int_stack_t *frame)
+{
+    uint64_t  t0  = cpu_rdtsc();
+    uintptr_t va  = (uintptr_t)cpu_read_cr2();
+    uint32_t  err = frame ? frame->err_code : 0;
+
+    g_pf_stats.faults++;
+    bool ok = pf_resolve(va, err);
+
+    uint64_t dt = cpu_rdtsc() - t0;
+    g_pf_stats.cycles_total += dt;
+    if (dt > g_pf_stats.cycles_max) {
+        g_pf_stats.cycles_max = (dt >> 32) ? 0xFFFFFFFFu : (uint32_t)dt;
+    }
+
+    if (!ok) {
+        g_pf_stats.unresolved++;
+        kprintf("\n#PF nao resolvido: endereco %p, erro 0x%x (%s, %s, %s)",
+                (void *)va, err,
+                (err & PF_ERR_PRESENT) ? "protecao" : "ausente",
+                (err & PF_ERR_WRITE) ? "escrita" : "leitura",
+                (err & PF_ERR_USER) ? "usuario" : "kernel");
+        if (vmalloc_is_guard(va)) {
+            kprintf("\n#PF: pagina de guarda do vmalloc (estouro do buffer anterior)");
+        }
+    }
+    return ok;
+}
+
+void page_fault_init(void)
+{
+    if (g_pf_ready) return;
+
+    g_zero_frame = pmm_alloc_zeroed_frame();
+    if (!g_zero_frame) {
+        panic("page_fault_init: sem frame para a pagina zero");
+    }
+    page_set_type(g_zero_frame, PAGE_TYPE_KERNEL);
+    // fica só com a referência da alocação: os mapeamentos não contam e
+    // nenhum caminho de desmapeamento a devolve (paging_frame_refcounted)
+    page_t *zp = phys_to_page(g_zero_frame);
+    if (zp) zp->flags |= PG_ZERO;
+
+    // sem WP o kernel escreveria na página zero sem gerar #PF
+    cpu_write_cr0(cpu_read_cr0() | (1u << CR0_WP_BIT));
+
+    g_kernel_space.dir = kernel_directory;
+    g_pf_ready = true;
+
+    kprintf("\npage fault: regioes sob demanda ativas, pagina zero em %p",
+            (void *)(uintptr_t)g_zero_frame);
+}
+
+bool page_fault_enabled(void)
+{
+    return g_pf_ready;
+}
+
+void page_fault_get_stats(page_fault_stats_t *out)
+{
+    if (!out) return;
+    uint32_t flags = cpu_irq_save();
+    *out = g_pf_stats;
+    cpu_irq_restore(flags);
+}
+
+void page_fault_print_stats(void)
+{
+    page_fault_stats_t st;
+    page_fault_get_stats(&st);
+
+    // média sem divisão de 64 bits: em Kciclos se o total não cabe em 32
+    uint32_t avg = 0;
+    if (st.faults) {
+        avg = (st.cycles_total >> 32)
+            ? (uint32_t)(st.cycles_total >> 10) / st.faults * 1024u
+            : (uint32_t)st.cycles_total / st.faults;
+    }
+
+    kprintf("\n#PF: %u faltas (zero: %u leituras, %u escritas, %u quebras;"
+            " %u COW, %u PDEs sync, %u espurias, %u sem solucao)",
+            st.faults, st.zero_maps, st.zero_fills, st.zero_breaks, st.cow_faults,
+            st.pde_syncs, st.spurious, st.unresolved);
+    kprintf("\n#PF: atendimento medio %u ciclos, maximo %u ciclos", avg, st.cycles_max);
+}
@@ -0,0 +1,93 @@
+#ifndef PAGE_FAULT_H
+#define PAGE_FAULT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "paging.h"
+#include "../pmm.h"
+#include "../../idt/isr.h"
+
+/* Bits do código de erro empilhado pelo #PF */
+#define PF_ERR_PRESENT  0x01u   /* 1: violação de proteção; 0: página ausente */
+#define PF_ERR_WRITE    0x02u   /* acesso de escrita                          */
+#define PF_ERR_USER     0x04u   /* acesso em ring 3                           */
+#define PF_ERR_RSVD     0x08u   /* bit reservado ligado numa entrada          */
+#define PF_ERR_FETCH    0x10u   /* busca de instrução (NX)                    */
+
+/* Regiões por espaço de endereçamento: o high-half tem uma lista única
+ * (igual em todo diretório); cada diretório de usuário tem a sua. */
+#ifndef VM_REGION_MAX
+#define VM_REGION_MAX 32u
+#endif
+
+#ifndef VM_SPACE_MAX
+#define VM_SPACE_MAX  8u
+#endif
+
+typedef enum vm_region_kind {
+    VM_REGION_DEMAND_ZERO = 1,  /* lê a página zero; a 1ª escrita aloca */
+} vm_region_kind_t;
+
+typedef struct vm_region {
+    uintptr_t start;    /* alinhado a página         */
+    uintptr_t end;      /* exclusivo                 */
+    uint32_t  flags;    /* PAGE_RW/PAGE_USER/... do mapeamento */
+    uint16_t  kind;     /* vm_region_kind_t          */
+    uint16_t  type;     /* page_type_t dos frames    */
+} vm_region_t;
+
+typedef struct {
+    uint32_t faults;        /* #PF recebidos                          */
+    uint32_t zero_maps;     /* leitura: página zero mapeada (só leitura) */
+    uint32_t zero_fills;    /* escrita em página ausente: frame novo  */
+    uint32_t zero_breaks;   /* escrita na página zero: frame próprio  */
+    uint32_t cow_faults;    /* escrita em PTE COW (cópia ou reuso)    */
+    uint32_t pde_syncs;     /* PDE do kernel copiada p/ outro diretório */
+    uint32_t spurious;      /* já mapeada: só TLB desatualizado       */
+    uint32_t unresolved;    /* terminaram em panic                    */
+    uint64_t cycles_total;  /* tempo de atendimento (rdtsc)           */
+    uint32_t cycles_max;
+} page_fault_stats_t;
+
+/* Aloca a página zero compartilhada, liga CR0.WP (para que escritas do
+ * kernel em páginas só leitura também gerem #PF) e arma o tratador.
+ * Deve ser chamada depois de idt_init(). */
+void page_fault_init(void);
+
+/* Tratador armado: regiões sob demanda podem ser usadas */
+bool page_fault_enabled(void);
+
+/* Chamado pelo vetor 14. Devolve true se a falta foi resolvida e a
+ * instrução pode ser repetida; false se deve terminar em panic. */
+bool page_fault_handle(int_stack_t *frame);
+
+/* Registra [start, start + size) como região demand-zero de 'dir'; os
+ * frames alocados nas faltas recebem o tipo 'type'. Endereços do
+ * high-half vão para a lista do kernel. Regiões vizinhas iguais são
+ * unidas. -1 se sobrepõe ou não há espaço. */
+int vm_region_add(page_directory_t *dir, uintptr_t start, size_t size,
+                  uint32_t flags, page_type_t type);
+
+/* Remove a faixa das regiões de 'dir', desfaz os mapeamentos e devolve
+ * os frames (page_put). Só aceita faixas contidas numa única região. */
+int vm_region_remove(page_directory_t *dir, uintptr_t start, size_t size);
+
+/* Copia para 'dst' as regiões de usuário de 'src' (clone COW).
+ * -1 se não houver espaço livre para 'dst'. */
+int vm_region_clone(page_directory_t *src, page_directory_t *dst);
+
+/* Esquece todas as regiões de usuário de 'dir' (sem tocar nos
+ * mapeamentos; usada por paging_destroy_directory) */
+void vm_space_release(page_directory_t *dir);
+
+/* Região de 'dir' que contém 'va' (NULL se nenhuma) */
+const vm_region_t *vm_region_find(page_directory_t *dir, uintptr_t va);
+
+/* Frame de zeros compartilhado (0 antes de page_fault_init) */
+phys_addr_t page_fault_zero_frame(void);
+
+void page_fault_get_stats(page_fault_stats_t *out);
+void page_fault_print_stats(void);
+
+#endif
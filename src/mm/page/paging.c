@@ -6,12 +6,43 @@
 #include "../../klib/panic.h"
 #include "../../cpu/cpu.h"
 #include "paging_kmap.h"
+#include "page_fault.h"
+#include "paging_cache.h"
 
 
 page_directory_t* current_directory = NULL;
 page_directory_t* kernel_directory  = NULL;
 static paging_ctx_t g_paging_ctx;
 
+bool g_paging_pae = false;
+bool g_paging_large = false;
+bool g_paging_global = false;
+
+/* Frames alocados/mapeados por vez em user_map_pages */
+#define PAGING_MAP_BATCH 64u
+
+/* Contadores de páginas grandes e de map/unmap (paging_print_stats) */
+static struct {
+    uint32_t boot_large;    // PDEs grandes criadas no paging_init_minimal
+    uint32_t boot_tables;   // PTs de 4 KiB criadas no paging_init_minimal
+    uint32_t large_mapped;  // paging_map_large em runtime
+    uint32_t splits;        // páginas grandes divididas numa PT
+    uint32_t large_live;    // PDEs grandes presentes agora
+    uint32_t pte_writes;    // PTEs escritas por map/unmap
+    uint32_t invlpgs;       // invlpg emitidos por map/unmap em faixa
+    uint32_t cr3_reloads;   // recargas de CR3 no lugar de muitos invlpg
+    uint32_t global_flushes;// TLB inteiro esvaziado alternando CR4.PGE
+    uint32_t cow_shared;    // frames compartilhados por paging_clone_directory_cow
+    uint32_t cow_copies;    // escritas COW que copiaram o frame
+    uint32_t cow_reused;    // escritas COW no último dono (sem cópia)
+    uint32_t pt_freed;      // PTs de usuário vazias devolvidas ao PMM
+    uint32_t dirs_freed;    // diretórios destruídos
+    uint32_t kernel_prealloc;// PTs do high-half alocadas no boot
+} g_paging_stats;
+
+/* PTs vazias guardadas até a invalidação do TLB (paging_range_apply) */
+#define PAGING_PT_FREE_BATCH 16u
+
 paging_ctx_t *get_paging_ctx(void) {
     return &g_paging_ctx;
 }
@@ -29,42 +60,113 @@ static inline page_directory_t * get_current_page_directory() {
 
 }
 inline uintptr_t virt_to_phys_kernel(uintptr_t va) {
+    if (physmap_contains_va(va)) {
+      return va - PHYSMAP_BASE;
+    }
     if (va >= KERNEL_VIRT_BASE) {
       return va - KERNEL_OFFSET;
    }
    return va; // bootstrap / identity
 }
 
-uintptr_t virt_to_phys_paging(uintptr_t virt)
+/* PDE de índice 'di' (vetor contínuo de PDs no PAE) */
+static inline uint64_t pde_get(const page_directory_t* dir, uint32_t di)
 {
-    // uint32_t pd_idx = (virt >> 22) & 0x3FF;
-    // uint32_t pt_idx = (virt >> 12) & 0x3FF;
-    uint32_t pd_idx = PD_INDEX(virt);
-    uint32_t pt_idx = PG_INDEX(virt);
-    uint32_t off    = virt & 0xFFF;
+    return paging_entry_get(dir->pde, di);
+}
 
+static inline void pde_set(page_directory_t* dir, uint32_t di, uint64_t value)
+{
+    paging_entry_set(dir->pde, di, value);
+}
+
+phys_addr_t virt_to_phys_paging(uintptr_t virt)
+{
     page_directory_t* dir = get_current_page_directory();
     if (!dir) return 0;
 
-    // PDE está em VA do dir (OK)
-    uint32_t pde = dir->pde[pd_idx];
-    if (!(pde & PAGE_PRESENT)) return 0;
+    return paging_get_physical(dir, &g_paging_ctx, virt);
+}
 
-    uintptr_t pt_phys = (uintptr_t)(pde & 0xFFFFF000u);
 
-    // PT é físico -> mapear temporariamente
-    uint32_t* pt = (uint32_t*)kmap(pt_phys);
-    uint32_t pte = pt[pt_idx];
-    kunmap();
 
-    if (!(pte & PAGE_PRESENT)) return 0;
-    return (pte & 0xFFFFF000u) + off;
+static inline void invlpg(uintptr_t va) {
+    asm volatile("invlpg (%0)" :: "r"(va) : "memory");
+}
+
+/**
+ * Escolhe o modo de paging. PAE só é usado se foi compilado
+ * (PAGING_PAE) e a CPU o anuncia em CPUID(1).EDX.
+ */
+bool paging_pae_probe(void)
+{
+#if PAGING_PAE
+    g_paging_pae = cpu_has_feature_edx(CPUID1_EDX_PAE_BIT) != 0;
+#else
+    g_paging_pae = false;
+#endif
+    return g_paging_pae;
+}
+
+/**
+ * Habilita PDEs grandes. No PAE o bit PS é sempre aceito (2 MiB); no modo
+ * de 32 bits depende do CPUID.PSE e de ligar CR4.PSE (4 MiB).
+ */
+static void paging_large_probe(void)
+{
+#if PAGING_PSE
+    if (g_paging_pae) {
+        g_paging_large = true;
+    } else if (cpu_has_feature_edx(CPUID1_EDX_PSE_BIT)) {
+        cpu_write_cr4(cpu_read_cr4() | (1u << CR4_PSE_BIT));
+        g_paging_large = true;
+    }
+#else
+    g_paging_large = false;
+#endif
+}
+
+/* Decide se os mapeamentos do kernel serão globais (CPUID.PGE). O CR4.PGE
+ * só é ligado depois que o diretório novo estiver ativo. */
+static void paging_global_probe(void)
+{
+#if PAGING_PGE
+    g_paging_global = cpu_has_feature_edx(CPUID1_EDX_PGE_BIT) != 0;
+#else
+    g_paging_global = false;
+#endif
 }
 
+/**
+ * Esvazia todo o TLB. Recarregar o CR3 não descarta entradas globais;
+ * desligar e religar CR4.PGE descarta.
+ */
+void paging_flush_tlb_global(void)
+{
+    uint32_t flags = cpu_irq_save();
+
+    if (g_paging_global) {
+        uint32_t cr4 = cpu_read_cr4();
+        cpu_write_cr4(cr4 & ~(1u << CR4_PGE_BIT));
+        cpu_write_cr4(cr4 | (1u << CR4_PGE_BIT));
+    } else {
+        paging_load_directory(cpu_read_cr3());
+    }
+    g_paging_stats.global_flushes++;
 
+    cpu_irq_restore(flags);
+}
 
-static inline void invlpg(uintptr_t va) {
-    asm volatile("invlpg (%0)" :: "r"(va) : "memory");
+size_t paging_directory_bytes(void)
+{
+    return g_paging_pae ? sizeof(page_directory_t) : PT_ENTRIES * sizeof(uint32_t);
+}
+
+/* Valor de CR3 para o diretório: o próprio diretório ou, no PAE, a PDPT */
+static uint32_t paging_directory_cr3(page_directory_t* dir, const paging_ctx_t* ctx)
+{
+    uintptr_t va = g_paging_pae ? (uintptr_t)dir->pdpt : (uintptr_t)dir;
+    return (uint32_t)va_to_pa(ctx, va);
 }
 
 /**
@@ -76,49 +178,71 @@ page_directory_t* paging_create_directory(const paging_ctx_t* ctx)
 {
     if (!ctx || !ctx->alloc_page_aligned) for(;;);
 
-    uintptr_t dir_v = ctx->alloc_page_aligned(sizeof(page_directory_t), PAGE_SIZE);
+    size_t bytes = paging_directory_bytes();
+
+    // com o paging ligado o boot_early já fechou: bloco já zerado do
+    // estoque de diretórios (PMM abaixo de 64 MiB, acessado pelo physmap)
+    uintptr_t dir_v;
+    if (g_physmap_size) {
+        phys_addr_t dir_p = paging_cache_alloc(PAGING_CACHE_DIR);
+        dir_v = dir_p ? physmap_va(dir_p) : 0;
+    } else {
+        dir_v = ctx->alloc_page_aligned(bytes, PAGE_SIZE);
+        if (dir_v) kmemset((void*)dir_v, 0, bytes);
+    }
     //if (!dir_v) for(;;);
     if (!dir_v) {
         panic("\npaging_create_directory: Erro ao alocar memory!");
     }
 
     page_directory_t* dir = (page_directory_t*)dir_v;
-    kmemset(dir, 0, sizeof(page_directory_t));
+
+    // PAE: PDPT aponta para os 4 PDs (PDPTEs só aceitam P/PWT/PCD)
+    if (g_paging_pae) {
+        for (uint32_t i = 0; i < PAE_PDPT_ENTRIES; ++i) {
+            uintptr_t pd_v = (uintptr_t)&dir->pde64[i * PAE_PT_ENTRIES];
+            dir->pdpt[i] = (uint64_t)va_to_pa(ctx, pd_v) | PAGE_PRESENT;
+        }
+    }
     return dir;
 }
 
 /* obtém PT física a partir do PDE */
-static inline uintptr_t pde_pt_phys(uint32_t pde_entry)
+static inline phys_addr_t pde_pt_phys(uint64_t pde_entry)
 {
-    return (uintptr_t)(pde_entry & 0xFFFFF000u);
+    return (phys_addr_t)(pde_entry & paging_addr_mask());
 }
 
-/* 
+/* PDE com PS = 1 (página grande) */
+static inline bool pde_is_large(uint64_t pde_entry)
+{
+    return (pde_entry & (PAGE_PRESENT | PAGE_4MB)) == (PAGE_PRESENT | PAGE_4MB);
+}
 
-garante que exista PT para o VA: cria sob demanda
- * - antes do paging ON: cria via ctx->alloc_page_aligned e zera direto
- * - depois do paging ON: cria via pmm_alloc_frame e zera via kmap
- */
-/**
- * Devolve o endereço físico do PT para o endereço informado. 
- * Caso não exista no PDE, um novo PT é criado e atribuído ao PDE.
- */
-static uintptr_t create_page_table(page_directory_t* dir, 
-                                    const paging_ctx_t* ctx,
-                                    uintptr_t virt, 
-                                    uint32_t pde_flags,
-                                    int paging_is_on)
+/* Base física de uma PDE grande. O bit 12 é PAT (e no PSE os bits 13-21
+ * são a extensão PSE-36), por isso a máscara vai até o tamanho da página. */
+static inline phys_addr_t pde_large_phys(uint64_t pde_entry)
 {
-    //Calcula a entrada/index no PD
-    uint32_t di = PD_INDEX(virt);
-    uint32_t pde = dir->pde[di];
+    return (phys_addr_t)(pde_entry & paging_addr_mask() &
+                         ~(uint64_t)(paging_large_size() - 1u));
+}
 
-    //Se o PT já existe, seu endereço físico é devolvido
-    if (pde & PAGE_PRESENT) {
-        return pde_pt_phys(pde);
-    }
+static inline uint64_t pde_make_large(phys_addr_t phys, uint32_t flags)
+{
+    return (phys & paging_addr_mask()) | (flags & 0xFFFu) | PAGE_4MB | PAGE_PRESENT;
+}
+
+/* Bits de uma PDE/PTE que valem tanto para página grande quanto para PT */
+#define PDE_COMMON_FLAGS (PAGE_PRESENT | PAGE_RW | PAGE_USER | PAGE_WRITETHRU | PAGE_NOCACHE)
 
-    uintptr_t pt_phys = 0;
+/**
+ * Aloca e zera uma PT:
+ * - antes do paging ON: via ctx->alloc_page_aligned (acessível direto)
+ * - depois do paging ON: pmm_alloc_zeroed_frame (pool de frames zerados)
+ */
+static phys_addr_t alloc_page_table(const paging_ctx_t* ctx, int paging_is_on)
+{
+    phys_addr_t pt_phys = 0;
 
     if (!paging_is_on) {
         // bootstrap: aloca acessível diretamente
@@ -129,21 +253,97 @@ static uintptr_t create_page_table(page_directory_t* dir,
         }
         kmemset((void*)pt_v, 0, sizeof(page_table_t));
         pt_phys = va_to_pa(ctx, pt_v);
+        g_paging_stats.boot_tables++;
     } else {
-        // runtime: aloca frame físico e zera via kmap
-        pt_phys = pmm_alloc_frame();
+        // runtime: PT já zerada do estoque (zona IDENTITY, acessada pelo
+        // physmap sem kmap); sem ela, frame zerado do pool do PMM
+        pt_phys = paging_cache_alloc(PAGING_CACHE_TABLE);
+        if (!pt_phys) {
+            pt_phys = pmm_alloc_zeroed_frame();
+        }
         //if (!pt_phys) for(;;);
         if (!pt_phys) {
             panic("\ncreate_page_table: Erro ao alocar memory!");
         }
-        page_table_t* pt = (page_table_t*)kmap(pt_phys);
-        kmemset(pt, 0, sizeof(page_table_t));
-        kunmap();
+        page_set_type(pt_phys, PAGE_TYPE_PAGETABLE);
     }
 
-    dir->pde[di] = (uint32_t)((pt_phys & 0xFFFFF000u) |
-                             (pde_flags & 0xFFFu) |
-                             PAGE_PRESENT);
+    return pt_phys;
+}
+
+/* Descritor de uma PT alocada no PMM; NULL para as PTs do boot, que não
+ * são devolvidas. page_t.priv guarda quantas entradas estão presentes. */
+static inline page_t* pt_page(phys_addr_t pt_phys)
+{
+    page_t* pg = phys_to_page(pt_phys);
+    return (pg && pg->refcount && pg->type == PAGE_TYPE_PAGETABLE) ? pg : NULL;
+}
+
+/**
+ * Divide a página grande da PDE 'di' numa PT com as mesmas traduções,
+ * para que um map/unmap de 4 KiB possa alterar só uma parte dela.
+ * Na PTE o bit 7 é PAT, então só as permissões e o cache são copiados.
+ */
+static phys_addr_t split_large_page(page_directory_t* dir,
+                                    const paging_ctx_t* ctx,
+                                    uint32_t di,
+                                    uint64_t pde,
+                                    int paging_is_on)
+{
+    phys_addr_t pt_phys = alloc_page_table(ctx, paging_is_on);
+    phys_addr_t base    = pde_large_phys(pde);
+    uint64_t    flags   = pde & (PDE_COMMON_FLAGS | PAGE_GLOBAL);
+    uint32_t    count   = (uint32_t)(paging_large_size() / PAGE_SIZE);
+
+    void* pt = paging_is_on ? (void*)kmap_atomic(pt_phys, KMAP_SLOT_PT)
+                            : (void*)(uintptr_t)pt_phys;
+    for (uint32_t i = 0; i < count; ++i) {
+        paging_entry_set(pt, i, (base + (phys_addr_t)i * PAGE_SIZE) | flags);
+    }
+    if (paging_is_on) kunmap_atomic(KMAP_SLOT_PT);
+
+    page_t* ptp = paging_is_on ? pt_page(pt_phys) : NULL;
+    if (ptp) ptp->priv = count;
+
+    pde_set(dir, di, (pt_phys & paging_addr_mask()) | (pde & PDE_COMMON_FLAGS));
+
+    // invlpg em qualquer endereço da página grande descarta a entrada inteira
+    invalid_tlb((uintptr_t)di * paging_large_size());
+    g_paging_stats.splits++;
+    g_paging_stats.large_live--;
+
+    return pt_phys;
+}
+
+/**
+ * Devolve o endereço físico do PT para o endereço informado. 
+ * Caso não exista no PDE, um novo PT é criado e atribuído ao PDE;
+ * se o PDE for uma página grande, ela é dividida numa PT.
+ */
+static phys_addr_t create_page_table(page_directory_t* dir, 
+                                    const paging_ctx_t* ctx,
+                                    uintptr_t virt, 
+                                    uint32_t pde_flags,
+                                    int paging_is_on)
+{
+    //Calcula a entrada/index no PD
+    uint32_t di = paging_pde_index(virt);
+    uint64_t pde = pde_get(dir, di);
+
+    if (pde_is_large(pde)) {
+        return split_large_page(dir, ctx, di, pde, paging_is_on);
+    }
+
+    //Se o PT já existe, seu endereço físico é devolvido
+    if (pde & PAGE_PRESENT) {
+        return pde_pt_phys(pde);
+    }
+
+    phys_addr_t pt_phys = alloc_page_table(ctx, paging_is_on);
+
+    pde_set(dir, di, (pt_phys & paging_addr_mask()) |
+                     (pde_flags & 0xFFFu) |
+                     PAGE_PRESENT);
 
     return pt_phys;
 }
@@ -157,10 +357,69 @@ static uintptr_t create_page_table(page_directory_t* dir,
 int paging_map(page_directory_t* dir, 
                 const paging_ctx_t* ctx,
                uintptr_t virt, 
-               uintptr_t phys, 
+               phys_addr_t phys, 
                uint32_t flags)
 {
-    if (!dir || !ctx) return -1;
+    return paging_map_range_contig(dir, ctx, virt & ~(uintptr_t)(PAGE_SIZE - 1),
+                                   phys & ~(phys_addr_t)(PAGE_SIZE - 1), 1, flags);
+}
+
+/* Invalidações de TLB acumuladas por uma operação em faixa */
+typedef struct tlb_batch {
+    uintptr_t va[PAGING_FLUSH_THRESHOLD];
+    uint32_t  count;    // páginas a invalidar (pode passar do vetor)
+    bool      global;   // alguma entrada antiga era global
+} tlb_batch_t;
+
+static inline void tlb_batch_add(tlb_batch_t* batch, uintptr_t va, uint64_t old)
+{
+    if (batch->count < PAGING_FLUSH_THRESHOLD) {
+        batch->va[batch->count] = va;
+    }
+    batch->count++;
+    if (old & PAGE_GLOBAL) batch->global = true;
+}
+
+/* invlpg por página até o limite; acima dele, recarrega o CR3 (ou, se
+ * havia entradas globais, que o CR3 não descarta, alterna o PGE) */
+static void tlb_batch_flush(tlb_batch_t* batch)
+{
+    if (batch->count == 0) return;
+
+    if (batch->count > PAGING_FLUSH_THRESHOLD) {
+        if (batch->global && g_paging_global) {
+            paging_flush_tlb_global();
+        } else {
+            paging_load_directory(cpu_read_cr3());
+            g_paging_stats.cr3_reloads++;
+        }
+    } else {
+        for (uint32_t i = 0; i < batch->count; ++i) {
+            invalid_tlb(batch->va[i]);
+        }
+        g_paging_stats.invlpgs += batch->count;
+    }
+    batch->count = 0;
+}
+
+/**
+ * Núcleo de map/unmap em faixa: para cada PT tocada, obtém a PT uma vez
+ * (criando ou dividindo página grande quando preciso), escreve as PTEs
+ * do trecho num laço e guarda as invalidações para o fim. Entradas que
+ * não eram presentes não estão no TLB e dispensam invalidação.
+ * Com 'map' falso, 'frames' e 'phys' são ignorados.
+ */
+static int paging_range_apply(page_directory_t* dir,
+                              const paging_ctx_t* ctx,
+                              uintptr_t virt,
+                              const phys_addr_t* frames,
+                              phys_addr_t phys,
+                              size_t npages,
+                              uint32_t flags,
+                              bool map)
+{
+    if (!dir || (map && !ctx)) return -1;
+    if (virt & (PAGE_SIZE - 1)) return -1;
 
     /**
      * Verifica se a paginação está ativa no registro CR0
@@ -171,81 +430,355 @@ int paging_map(page_directory_t* dir,
             panic("\npaging_map: paginação não está ativa!");
     }
 
+    uint64_t addr_mask = paging_addr_mask();
+
+    // Sem PAE não há como endereçar frames acima de 4 GiB: valida antes
+    // de escrever qualquer PTE
+    if (map) {
+        if (frames) {
+            for (size_t i = 0; i < npages; ++i) {
+                if (frames[i] & ~addr_mask & ~0xFFFull) return -1;
+            }
+        } else if (npages && ((phys + (phys_addr_t)(npages - 1) * PAGE_SIZE) & ~addr_mask & ~0xFFFull)) {
+            return -1;
+        }
+    }
+
     uint32_t pde_flags = PAGE_RW;
     if (flags & PAGE_USER) {
         pde_flags |= PAGE_USER;
     }
+    uint64_t pte_flags = (flags & 0xFFFu) | PAGE_PRESENT;
+    uint32_t per_pt    = paging_pt_entries();
+
+    tlb_batch_t batch;
+    batch.count  = 0;
+    batch.global = false;
+
+    phys_addr_t pt_free[PAGING_PT_FREE_BATCH];
+    uint32_t    pt_free_count = 0;
+
+    size_t done = 0;
+    while (done < npages) {
+        uintptr_t va = virt + (uintptr_t)done * PAGE_SIZE;
+        uint32_t  ti = paging_pte_index(va);
+        size_t    n  = per_pt - ti;
+        if (n > npages - done) n = npages - done;
+
+        phys_addr_t pt_phys;
+        if (map) {
+            pt_phys = create_page_table(dir, ctx, va, pde_flags, paging_on);
+        } else {
+            uint32_t di  = paging_pde_index(va);
+            uint64_t pde = pde_get(dir, di);
+
+            if (!(pde & PAGE_PRESENT)) {
+                done += n;
+                continue;
+            }
+            if (pde_is_large(pde)) {
+                if (ti == 0 && n == per_pt) {
+                    // página grande inteira: some a PDE, sem dividir
+                    pde_set(dir, di, 0);
+                    tlb_batch_add(&batch, va, pde);
+                    g_paging_stats.large_live--;
+                    done += n;
+                    continue;
+                }
+                pt_phys = split_large_page(dir, ctx, di, pde, paging_on);
+            } else {
+                pt_phys = pde_pt_phys(pde);
+            }
+        }
 
-    uintptr_t pt_phys = create_page_table(dir, ctx, virt, pde_flags, paging_on);
-
-    // acessa PT via kmap
-    page_table_t* pt = (page_table_t*)kmap(pt_phys);
+        // acessa PT pelo physmap (ou slot do kmap)
+        void* pt = (void*)kmap_atomic(pt_phys, KMAP_SLOT_PT);
+        int32_t live = 0;
+
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t value = 0;
+            if (map) {
+                phys_addr_t pa = frames ? frames[done + i]
+                                        : phys + (phys_addr_t)(done + i) * PAGE_SIZE;
+                value = (pa & addr_mask) | pte_flags;
+            }
+
+            uint64_t old = paging_entry_get(pt, ti + (uint32_t)i);
+            paging_entry_set(pt, ti + (uint32_t)i, value);
+
+            if (old & PAGE_PRESENT) {
+                tlb_batch_add(&batch, va + (uintptr_t)i * PAGE_SIZE, old);
+                live--;
+            }
+            if (map) live++;
+        }
+        g_paging_stats.pte_writes += (uint32_t)n;
+
+        kunmap_atomic(KMAP_SLOT_PT);
+        done += n;
+
+        page_t* ptp = pt_page(pt_phys);
+        if (!ptp) continue;
+        ptp->priv = (uint32_t)((int32_t)ptp->priv + live);
+
+        // PT de usuário vazia: some a PDE agora, o frame só volta ao PMM
+        // depois da invalidação (que também descarta a PDE em cache).
+        // PTs do high-half ficam: a PDE está copiada em outros diretórios.
+        if (!map && ptp->priv == 0 && va < KERNEL_VIRT_BASE && dir != kernel_directory) {
+            pde_set(dir, paging_pde_index(va), 0);
+            tlb_batch_add(&batch, va, 0);
+            pt_free[pt_free_count++] = pt_phys;
+
+            if (pt_free_count == PAGING_PT_FREE_BATCH) {
+                tlb_batch_flush(&batch);
+                for (uint32_t k = 0; k < pt_free_count; ++k) {
+                    paging_cache_free(PAGING_CACHE_TABLE, pt_free[k], true);
+                }
+                g_paging_stats.pt_freed += pt_free_count;
+                pt_free_count = 0;
+            }
+        }
+    }
 
-    uint32_t ti = PG_INDEX(virt);
-    pt->entries[ti] = (uint32_t)((phys & 0xFFFFF000u) |
-                                (flags & 0xFFFu) |
-                                PAGE_PRESENT);
+    tlb_batch_flush(&batch);
+    // sem nenhuma entrada a PT já está zerada: volta ao estoque
+    for (uint32_t k = 0; k < pt_free_count; ++k) {
+        paging_cache_free(PAGING_CACHE_TABLE, pt_free[k], true);
+    }
+    g_paging_stats.pt_freed += pt_free_count;
+    return 0;
+}
 
-    kunmap();    
-    invalid_tlb(virt);
+int paging_map_range(page_directory_t* dir,
+                     const paging_ctx_t* ctx,
+                     uintptr_t virt,
+                     const phys_addr_t* frames,
+                     size_t npages,
+                     uint32_t flags)
+{
+    if (!frames) return -1;
+    return paging_range_apply(dir, ctx, virt, frames, 0, npages, flags, true);
+}
 
-    return 0;
+int paging_map_range_contig(page_directory_t* dir,
+                            const paging_ctx_t* ctx,
+                            uintptr_t virt,
+                            phys_addr_t phys,
+                            size_t npages,
+                            uint32_t flags)
+{
+    if (phys & (PAGE_SIZE - 1)) return -1;
+    return paging_range_apply(dir, ctx, virt, NULL, phys, npages, flags, true);
 }
 
-int paging_unmap(page_directory_t* dir, const paging_ctx_t* ctx, uintptr_t virt)
+int paging_unmap_range(page_directory_t* dir,
+                       const paging_ctx_t* ctx,
+                       uintptr_t virt,
+                       size_t npages)
 {
-    (void)ctx;
-    if (!dir) return -1;
+    return paging_range_apply(dir, ctx, virt, NULL, 0, npages, 0, false);
+}
 
-    uint32_t di = PD_INDEX(virt);
-    uint32_t pde = dir->pde[di];
-    if (!(pde & PAGE_PRESENT)) return 0;
+/**
+ * Mapeia uma página grande inteira numa PDE. Só substitui PDE vazia ou
+ * outra página grande: uma PT existente pode ter mapeamentos de 4 KiB.
+ */
+int paging_map_large(page_directory_t* dir,
+                     const paging_ctx_t* ctx,
+                     uintptr_t virt,
+                     phys_addr_t phys,
+                     uint32_t flags)
+{
+    if (!dir || !ctx || !g_paging_large) return -1;
 
-    uintptr_t pt_phys = pde_pt_phys(pde);
-    page_table_t* pt = (page_table_t*)kmap(pt_phys);
+    uintptr_t large = paging_large_size();
+    if ((virt & (large - 1)) || (phys & (large - 1))) return -1;
+    if (phys & ~paging_addr_mask()) return -1;
 
-    uint32_t ti = PG_INDEX(virt);
-    pt->entries[ti] = 0;
+    uint32_t di = paging_pde_index(virt);
+    uint64_t pde = pde_get(dir, di);
+    if (!paging_large_slot_free(dir, virt)) return -1;
 
-    kunmap();
-    //invlpg(virt);
+    pde_set(dir, di, pde_make_large(phys, flags));
     invalid_tlb(virt);
+    g_paging_stats.large_mapped++;
+    if (!(pde & PAGE_PRESENT)) g_paging_stats.large_live++;
 
     return 0;
 }
 
-uintptr_t paging_get_physical(page_directory_t* dir, const paging_ctx_t* ctx, uintptr_t virt)
+bool paging_large_slot_free(page_directory_t* dir, uintptr_t virt)
+{
+    if (!dir) return false;
+    uint64_t pde = pde_get(dir, paging_pde_index(virt));
+    return !(pde & PAGE_PRESENT) || pde_is_large(pde);
+}
+
+int paging_unmap(page_directory_t* dir, const paging_ctx_t* ctx, uintptr_t virt)
+{
+    return paging_unmap_range(dir, ctx, virt & ~(uintptr_t)(PAGE_SIZE - 1), 1);
+}
+
+phys_addr_t paging_get_physical(page_directory_t* dir, const paging_ctx_t* ctx, uintptr_t virt)
 {
     (void)ctx;
     if (!dir) return 0;
 
-    uint32_t di = PD_INDEX(virt);
-    uint32_t pde = dir->pde[di];
+    uint32_t di = paging_pde_index(virt);
+    uint64_t pde = pde_get(dir, di);
     if (!(pde & PAGE_PRESENT)) return 0;
 
-    uintptr_t pt_phys = pde_pt_phys(pde);
-    page_table_t* pt = (page_table_t*)kmap(pt_phys);
+    if (pde_is_large(pde)) {
+        return pde_large_phys(pde) | (virt & (paging_large_size() - 1u));
+    }
 
-    uint32_t ti = PG_INDEX(virt);
-    uint32_t e = pt->entries[ti];
+    phys_addr_t pt_phys = pde_pt_phys(pde);
+    void* pt = (void*)kmap_atomic(pt_phys, KMAP_SLOT_PT);
 
-    kunmap();
+    uint32_t ti = paging_pte_index(virt);
+    uint64_t e = paging_entry_get(pt, ti);
+
+    kunmap_atomic(KMAP_SLOT_PT);
 
     if (!(e & PAGE_PRESENT)) return 0;
-    return (uintptr_t)((e & 0xFFFFF000u) | (virt & 0xFFFu));
+    return (phys_addr_t)((e & paging_addr_mask()) | (virt & 0xFFFu));
+}
+
+/**
+ * Mapeia [virt, virt + size) -> phys no bootstrap. Onde VA e PA estão
+ * alinhados à página grande e o trecho a cobre inteira, usa uma PDE
+ * grande; o resto vai para PTs de 4 KiB (acessíveis pelo identity).
+ */
+static void paging_boot_map_range(const paging_ctx_t* ctx,
+                                  uintptr_t virt,
+                                  uintptr_t phys,
+                                  uintptr_t size,
+                                  uint32_t flags)
+{
+    uintptr_t large = paging_large_size();
+    uintptr_t end   = virt + size;
+
+    while (virt < end) {
+        uint32_t di = paging_pde_index(virt);
+
+        if (g_paging_large && !((virt | phys) & (large - 1)) &&
+            end - virt >= large &&
+            !(pde_get(kernel_directory, di) & PAGE_PRESENT)) {
+            pde_set(kernel_directory, di, pde_make_large(phys, flags));
+            g_paging_stats.boot_large++;
+            g_paging_stats.large_live++;
+            virt += large;
+            phys += large;
+            continue;
+        }
+
+        //Devolve o PT para o endereço. Se não existir, cria um e devolve.
+        phys_addr_t pt_phys = create_page_table(kernel_directory, ctx, virt, PAGE_RW, false);
+
+        // pt é acessível diretamente porque alocado via alloc_page_aligned (bootstrap identity)
+        void* pt = (void*)(uintptr_t)pt_phys;
+        uint32_t ti = paging_pte_index(virt);
+        paging_entry_set(pt, ti, (uint64_t)phys | (flags & 0xFFFu) | PAGE_PRESENT);
+
+        virt += PAGE_SIZE;
+        phys += PAGE_SIZE;
+    }
+}
+
+int paging_sync_kernel_pde(page_directory_t* dir, uintptr_t virt)
+{
+    if (!dir || !kernel_directory || dir == kernel_directory) return 0;
+
+    uint32_t di = paging_pde_index(virt);
+    uint64_t kpde = pde_get(kernel_directory, di);
+    if (!(kpde & PAGE_PRESENT) || pde_get(dir, di) == kpde) return 0;
+
+    pde_set(dir, di, kpde);
+    return 1;
+}
+
+/**
+ * Dá uma PT a toda PDE vazia do high-half do kernel_directory. Como os
+ * diretórios de usuário copiam essas PDEs na criação e elas nunca mudam,
+ * qualquer mapeamento posterior do kernel aparece em todos eles. As PTs
+ * vêm de um bloco contíguo abaixo de 64 MiB, zerado pelo physmap, e
+ * ficam fixas (PG_PINNED). Precisa do vetor page_t e deve rodar antes
+ * do primeiro diretório de usuário.
+ *
+ * As PDEs de [skip_start, skip_end) ficam vazias para poderem receber
+ * páginas grandes depois (a janela da heap); essas chegam aos outros
+ * diretórios por paging_sync_kernel_pde() no #PF.
+ */
+void paging_prealloc_kernel_tables(const paging_ctx_t* ctx,
+                                   uintptr_t skip_start, uintptr_t skip_end)
+{
+    if (!kernel_directory || !ctx) return;
+
+    uint32_t first = paging_pde_index(ctx->kernel_virt_base);
+    uint32_t count = g_paging_pae ? PAE_PDE_ENTRIES : PT_ENTRIES;
+    uint32_t skip0 = paging_pde_index(skip_start);
+    uint32_t skip1 = (skip_end > skip_start) ? paging_pde_index(skip_end - 1u) + 1u : skip0;
+    uint32_t need  = 0;
+    uint32_t large = 0;
+    uint32_t kept  = 0;
+
+    for (uint32_t di = first; di < count; ++di) {
+        uint64_t pde = pde_get(kernel_directory, di);
+        if (!(pde & PAGE_PRESENT)) {
+            if (di >= skip0 && di < skip1) kept++;
+            else                           need++;
+        } else if (pde_is_large(pde)) {
+            large++;
+        }
+    }
+
+    if (need) {
+        size_t      bytes = (size_t)need * PAGE_SIZE;
+        phys_addr_t base  = pmm_alloc_contig(bytes, PAGE_SIZE, 0, PMM_ZONE_IDENTITY_LIMIT);
+        uintptr_t   va    = base ? physmap_va(base) : 0;
+        if (!va || !physmap_va(base + bytes - 1u)) {
+            panic("\npaging_prealloc_kernel_tables: sem memoria para as PTs do kernel");
+        }
+        kmemzero((void*)va, bytes);
+
+        phys_addr_t pt = base;
+        for (uint32_t di = first; di < count; ++di) {
+            if (pde_get(kernel_directory, di) & PAGE_PRESENT) continue;
+            if (di >= skip0 && di < skip1) continue;
+
+            page_set_type(pt, PAGE_TYPE_PAGETABLE);
+            page_t* pg = phys_to_page(pt);
+            if (pg) pg->flags |= PG_PINNED;
+
+            // PDE nova (não presente antes): dispensa invalidação
+            pde_set(kernel_directory, di, (pt & paging_addr_mask()) | PAGE_PRESENT | PAGE_RW);
+            pt += PAGE_SIZE;
+        }
+        g_paging_stats.kernel_prealloc = need;
+    }
+
+    kprintf("\npaging: high-half com %u PTs pre-alocadas (%u KiB fixos), %u PDEs grandes,"
+            " %u PTs ja existentes, %u PDEs livres para paginas grandes",
+            (unsigned)need, (unsigned)(need * (PAGE_SIZE / 1024u)), (unsigned)large,
+            (unsigned)(count - first - need - large - kept), (unsigned)kept);
 }
 
 /* init minimal:
  * - cria kernel_directory
  * - inicializa KMAP (PT reservada) ainda no bootstrap
- * - identity-map só até bootstrap_identity_limit (sem 4GiB!)
- * - mapeia kernel high-half
+ * - identity-map só até bootstrap_identity_limit (sem 4GiB!), em
+ *   páginas grandes quando disponíveis
+ * - mapeia kernel high-half (páginas grandes só se VA e PA alinharem)
  * - liga paging
  */
 void paging_init_minimal(const paging_ctx_t* ctx)
 {
     if (!ctx || !ctx->alloc_page_aligned) for(;;);
 
+    // PSE/PAE decide o tamanho das páginas grandes do mapeamento inicial
+    paging_large_probe();
+    paging_global_probe();
+
     //Aloca e devolve um bloco de 4096 bytes para o page_directory
     kernel_directory = paging_create_directory(ctx);
 
@@ -257,6 +790,9 @@ void paging_init_minimal(const paging_ctx_t* ctx)
 
     uint32_t kflags = (ctx->kernel_page_flags & 0xFFFu) | PAGE_RW;
 
+    // high-half: igual em todo diretório, então global (identity não)
+    uint32_t kflags_high = kflags | paging_kernel_global();
+
     // identity limit
     uintptr_t id_limit = ctx->bootstrap_identity_limit;
     if (id_limit == 0) {
@@ -265,96 +801,380 @@ void paging_init_minimal(const paging_ctx_t* ctx)
     //id_limit = (id_limit / PAGE_SIZE) * PAGE_SIZE;
     id_limit = ALIGN_DOWN(id_limit, PAGE_SIZE);
 
-    //Fixo como falso, porque estamos realizado o pagging inicial e precisamos 
-    //usar boot_early_alloc. 
-    int paging_on = false;
-
-
-   
-    /* Faz o mapeamento identity-mapped.
-       "paging_is_on" é informado como  falso.
-       pagging identity: Virt 0-id_limit
-       criamos PTs via alloc_page_aligned (sem kmap)
+    /* Faz o mapeamento identity-mapped (Virt 0-id_limit). As PTs, quando
+       necessárias, vêm de alloc_page_aligned: paging_map ainda não pode
+       ser usada porque depende do kmap no diretório ativo.
     */
-    for (uintptr_t phys = 0; phys < id_limit; phys += PAGE_SIZE) {
-        
-        uint32_t pde_flags = PAGE_RW;
-
-        //Devolve o PT para o endereço. Se não existir, cria um e devolve.
-        uintptr_t pt_phys = create_page_table(kernel_directory, ctx, phys, pde_flags, paging_on);
-
-        // pt é acessível diretamente porque alocado via alloc_page_aligned (bootstrap identity)
-        page_table_t* pt = (page_table_t*)pt_phys; // válido no bootstrap identity
-        uint32_t ti = PG_INDEX(phys);
-        pt->entries[ti] = (uint32_t)((phys & 0xFFFFF000u) | (kflags & 0xFFFu) | PAGE_PRESENT);
-    }
+    paging_boot_map_range(ctx, 0, 0, id_limit, kflags);
 
     // mapeia apenas o espaço ocupado pelo kernel high-half
-    for (uintptr_t phys = ctx->kernel_phys_start; phys < ctx->kernel_phys_end; phys += PAGE_SIZE) {
-
+    uintptr_t k_start = ALIGN_DOWN(ctx->kernel_phys_start, PAGE_SIZE);
+    uintptr_t k_size  = ALIGN_UP(ctx->kernel_phys_end, PAGE_SIZE) - k_start;
+    paging_boot_map_range(ctx, ctx->kernel_virt_base, k_start, k_size, kflags_high);
+
+    // physmap: memória física baixa em PHYSMAP_BASE (páginas grandes)
+    uintptr_t physmap_size = ctx->physmap_size;
+    if (physmap_size == 0 || physmap_size > PHYSMAP_MAX_SIZE) {
+        physmap_size = PHYSMAP_MAX_SIZE;
+    }
+    physmap_size = ALIGN_UP(physmap_size, g_paging_large ? paging_large_size() : PAGE_SIZE);
+    if (physmap_size > PHYSMAP_MAX_SIZE) physmap_size = PHYSMAP_MAX_SIZE;
+    paging_boot_map_range(ctx, PHYSMAP_BASE, 0, physmap_size, kflags_high);
 
-        uintptr_t virt = ctx->kernel_virt_base + (phys - ctx->kernel_phys_start);
+    // carrega CR3 com físico do diretório
+    uint32_t cr3_phys = paging_directory_cr3(kernel_directory, ctx);
+
+    if (g_paging_pae) {
+        /* CR4.PAE só muda com o paging desligado. A rotina roda pelo
+           alias identity (coberto pelas tabelas antigas e novas) e não
+           toca na pilha enquanto PG = 0. */
+        void (*enable_pae)(uint32_t) =
+            (void (*)(uint32_t))virt_to_phys_kernel((uintptr_t)paging_enable_pae);
+        enable_pae(cr3_phys);
+    } else {
+        paging_load_directory(cr3_phys);
+        paging_enable();
+    }
 
-        uint32_t pde_flags = PAGE_RW;
-        uintptr_t pt_phys = create_page_table(kernel_directory, ctx, virt, pde_flags, paging_on);
+    // só agora o physmap está no diretório ativo
+    g_physmap_size = physmap_size;
 
-        // bootstrap identity: pt_phys acessível direto
-        page_table_t* pt = (page_table_t*)pt_phys;
-        uint32_t ti = PG_INDEX(virt);
-        pt->entries[ti] = (uint32_t)((phys & 0xFFFFF000u) | (kflags & 0xFFFu) | PAGE_PRESENT);
+    // PAGE_GLOBAL passa a valer com o diretório novo já carregado
+    if (g_paging_global) {
+        cpu_write_cr4(cpu_read_cr4() | (1u << CR4_PGE_BIT));
     }
 
-    // carrega CR3 com físico do diretório
-    uint32_t cr3_phys = (uint32_t)va_to_pa(ctx, (uintptr_t)kernel_directory);
-    paging_load_directory(cr3_phys);
-    paging_enable();
+    kprintf("\npaging: modo %s", g_paging_pae ? "PAE (64 bits por entrada)" : "32 bits");
+    if (g_paging_large) {
+        kprintf(", paginas grandes de %u KiB", (unsigned)(paging_large_size() >> 10));
+    }
+    if (g_paging_global) {
+        kprintf(", kernel global (PGE)");
+    }
+    kprintf("\npaging: physmap %p - %p (%u MiB)", (void*)PHYSMAP_BASE,
+            (void*)(PHYSMAP_BASE + physmap_size - 1u), (unsigned)(physmap_size >> 20));
 
-    // daqui em diante: use paging_map/unmap/get_physical (elas usam kmap)
+    // daqui em diante: use paging_map/unmap/get_physical (physmap ou kmap)
 }
 
-/* troca diretório */
+/* troca diretório: as entradas globais do high-half ficam no TLB */
 void paging_switch_directory(page_directory_t* dir, const paging_ctx_t* ctx)
 {
     if (!dir) return;
     current_directory = dir;
-    uint32_t cr3_phys = (uint32_t)va_to_pa(ctx, (uintptr_t)dir);
-    paging_load_directory(cr3_phys);
+    paging_load_directory(paging_directory_cr3(dir, ctx));
 }
 
-/* cria diretório user copiando o high-half do kernel */
+/* cria diretório user copiando o high-half do kernel. Com
+ * PAGING_KERNEL_PREALLOC essas PDEs já apontam para PTs fixas, então a
+ * cópia vale para sempre; as da janela da heap deixadas vazias para
+ * páginas grandes chegam depois pelo #PF. */
 page_directory_t* paging_create_user_directory_from_kernel(const paging_ctx_t* ctx,
                                                            const page_directory_t* kdir)
 {
     page_directory_t* udir = paging_create_directory(ctx);
 
     // copia apenas high-half: assume kernel_virt_base alinhado 4MiB (ex.: 0xC0000000)
-    uint32_t start = PD_INDEX(ctx->kernel_virt_base);
-    for (uint32_t i = start; i < 1024u; ++i) {
-        udir->pde[i] = kdir->pde[i];
+    uint32_t start = paging_pde_index(ctx->kernel_virt_base);
+    uint32_t count = g_paging_pae ? PAE_PDE_ENTRIES : PT_ENTRIES;
+    for (uint32_t i = start; i < count; ++i) {
+        pde_set(udir, i, pde_get(kdir, i));
     }
 
     return udir;
 }
 
+/* Devolve ao PMM um diretório criado com o paging ligado (ainda sem PTs) */
+static void paging_free_directory_frames(page_directory_t* dir)
+{
+    if (physmap_contains_va((uintptr_t)dir)) {
+        paging_cache_free(PAGING_CACHE_DIR, (phys_addr_t)((uintptr_t)dir - PHYSMAP_BASE), false);
+    }
+}
+
+/* Frames cujas PTEs contam referência: os do PMM, menos a página zero,
+ * que fica fixa com a referência da alocação e pode ter qualquer número
+ * de mapeamentos sem estourar o refcount de 16 bits */
+static inline bool paging_frame_refcounted(const page_t* page)
+{
+    return page && page->refcount && !(page->flags & PG_ZERO);
+}
+
+/**
+ * Cria um diretório de usuário que compartilha todos os frames de 'src'.
+ * Cada PT da metade de usuário é duplicada; as PTEs graváveis perdem
+ * PAGE_RW e ganham PAGE_COW nos dois diretórios, e cada frame ganha uma
+ * referência. A primeira escrita de qualquer lado passa por
+ * paging_cow_fault(). As regiões sob demanda de 'src' são herdadas.
+ */
+page_directory_t* paging_clone_directory_cow(const paging_ctx_t* ctx, page_directory_t* src)
+{
+    if (!ctx || !src || src == kernel_directory) return NULL;
+
+    page_directory_t* dst = paging_create_user_directory_from_kernel(ctx, kernel_directory);
+    if (vm_region_clone(src, dst) != 0) {
+        paging_free_directory_frames(dst);
+        return NULL;
+    }
+
+    uint32_t end      = paging_pde_index(ctx->kernel_virt_base);
+    uint32_t entries  = paging_pt_entries();
+    bool     write_rm = false;
+
+    for (uint32_t di = 0; di < end; ++di) {
+        uint64_t pde = pde_get(src, di);
+        if (!(pde & PAGE_PRESENT)) continue;
+
+        // páginas grandes só aparecem no kernel; se houver, ficam como estão
+        if (pde_is_large(pde)) {
+            pde_set(dst, di, pde);
+            continue;
+        }
+
+        phys_addr_t dpt_phys = alloc_page_table(ctx, true);
+        pde_set(dst, di, (dpt_phys & paging_addr_mask()) | (pde & PDE_COMMON_FLAGS));
+
+        uint32_t irq = cpu_irq_save();
+        void* spt = (void*)kmap_atomic(pde_pt_phys(pde), KMAP_SLOT_SRC);
+        void* dpt = (void*)kmap_atomic(dpt_phys, KMAP_SLOT_DST);
+
+        uint32_t copied = 0;
+        for (uint32_t ti = 0; ti < entries; ++ti) {
+            uint64_t e = paging_entry_get(spt, ti);
+            if (!(e & PAGE_PRESENT)) continue;
+            copied++;
+
+            phys_addr_t phys = (phys_addr_t)(e & paging_addr_mask());
+            page_t* page = phys_to_page(phys);
+
+            // frames sem dono no PMM (MMIO, reservados) e a página zero
+            // (só leitura, nunca liberada) só são copiados
+            if (paging_frame_refcounted(page)) {
+                if (e & PAGE_RW) {
+                    e = (e & ~(uint64_t)PAGE_RW) | PAGE_COW;
+                    paging_entry_set(spt, ti, e);
+                    write_rm = true;
+                }
+                page->flags |= PG_COW;
+                page_get(phys);
+                g_paging_stats.cow_shared++;
+            }
+            paging_entry_set(dpt, ti, e);
+        }
+
+        kunmap_atomic(KMAP_SLOT_DST);
+        kunmap_atomic(KMAP_SLOT_SRC);
+        cpu_irq_restore(irq);
+
+        page_t* dptp = pt_page(dpt_phys);
+        if (dptp) dptp->priv = copied;
+    }
+
+    // PTEs do pai perderam PAGE_RW: uma recarga de CR3 basta (não são globais)
+    if (write_rm && src == current_directory) {
+        paging_load_directory(paging_directory_cr3(src, ctx));
+        g_paging_stats.cr3_reloads++;
+    }
+
+    return dst;
+}
+
+int paging_cow_fault(page_directory_t* dir, const paging_ctx_t* ctx,
+                     uintptr_t virt, bool user)
+{
+    if (!dir) return 0;
+
+    uintptr_t page = virt & ~(uintptr_t)(PAGE_SIZE - 1);
+    uint64_t  pde  = pde_get(dir, paging_pde_index(page));
+    if (!(pde & PAGE_PRESENT) || pde_is_large(pde)) return 0;
+
+    void* pt = (void*)kmap_atomic(pde_pt_phys(pde), KMAP_SLOT_PT);
+    uint64_t e = paging_entry_get(pt, paging_pte_index(page));
+    kunmap_atomic(KMAP_SLOT_PT);
+
+    if ((e & (PAGE_PRESENT | PAGE_COW)) != (PAGE_PRESENT | PAGE_COW)) return 0;
+    if (user && !(e & PAGE_USER)) return 0;
+
+    phys_addr_t old   = (phys_addr_t)(e & paging_addr_mask());
+    uint32_t    flags = ((uint32_t)e & 0xFFFu & ~(PAGE_COW | PAGE_ACCESSED | PAGE_DIRTY)) | PAGE_RW;
+    page_t*     pg    = phys_to_page(old);
+
+    // último dono: devolve a escrita no próprio frame
+    if (pg && pg->refcount == 1) {
+        pg->flags &= (uint8_t)~PG_COW;
+        paging_map(dir, ctx, page, old, flags);
+        g_paging_stats.cow_reused++;
+        return 1;
+    }
+
+    phys_addr_t copy = pmm_alloc_frame_for_va(page);
+    if (!copy) return -1;
+
+    kmap_copy_frame(copy, old);
+    page_set_type(copy, pg ? (page_type_t)pg->type : PAGE_TYPE_USER);
+    if (paging_map(dir, ctx, page, copy, flags) != 0) {
+        pmm_free_frame(copy);
+        return -1;
+    }
+    if (pg) page_put(old);
+    g_paging_stats.cow_copies++;
+    return 1;
+}
+
+int paging_unmap_release(page_directory_t* dir, const paging_ctx_t* ctx,
+                         uintptr_t virt, size_t npages)
+{
+    phys_addr_t frames[PAGING_MAP_BATCH];
+
+    for (size_t done = 0; done < npages; ) {
+        uintptr_t va = virt + (uintptr_t)done * PAGE_SIZE;
+        size_t    n  = npages - done;
+        if (n > PAGING_MAP_BATCH) n = PAGING_MAP_BATCH;
+
+        for (size_t i = 0; i < n; ++i) {
+            frames[i] = paging_get_physical(dir, ctx, va + (uintptr_t)i * PAGE_SIZE);
+        }
+
+        // primeiro some o mapeamento (e o TLB), depois o frame volta ao PMM
+        if (paging_unmap_range(dir, ctx, va, n) != 0) return -1;
+        for (size_t i = 0; i < n; ++i) {
+            if (frames[i] && paging_frame_refcounted(phys_to_page(frames[i]))) {
+                page_put(frames[i]);
+            }
+        }
+        done += n;
+    }
+    return 0;
+}
+
+/**
+ * Destrói um diretório de usuário numa passada: cada PTE presente da
+ * metade de usuário solta a referência do seu frame e cada PT do PMM
+ * volta a ele, sem invalidar página a página. Só um CR3 é carregado, e
+ * apenas se 'dir' estava ativo. O high-half é compartilhado e fica.
+ */
+void paging_destroy_directory(page_directory_t* dir)
+{
+    if (!dir || dir == kernel_directory) return;
+
+    // sai do diretório antes de desmontá-lo (a única troca de TLB)
+    if (dir == current_directory) {
+        paging_switch_directory(kernel_directory, &g_paging_ctx);
+    }
+
+    uint32_t end     = paging_pde_index(KERNEL_VIRT_BASE);
+    uint32_t entries = paging_pt_entries();
+
+    for (uint32_t di = 0; di < end; ++di) {
+        uint64_t pde = pde_get(dir, di);
+        if (!(pde & PAGE_PRESENT)) continue;
+        pde_set(dir, di, 0);
+        if (pde_is_large(pde)) continue;
+
+        phys_addr_t pt_phys = pde_pt_phys(pde);
+        void* pt = (void*)kmap_atomic(pt_phys, KMAP_SLOT_PT);
+        for (uint32_t ti = 0; ti < entries; ++ti) {
+            uint64_t e = paging_entry_get(pt, ti);
+            if (!(e & PAGE_PRESENT)) continue;
+
+            phys_addr_t phys = (phys_addr_t)(e & paging_addr_mask());
+            if (paging_frame_refcounted(phys_to_page(phys))) page_put(phys);
+        }
+        kunmap_atomic(KMAP_SLOT_PT);
+
+        if (pt_page(pt_phys)) {
+            paging_cache_free(PAGING_CACHE_TABLE, pt_phys, false);
+            g_paging_stats.pt_freed++;
+        }
+    }
+
+    vm_space_release(dir);
+    paging_free_directory_frames(dir);
+    g_paging_stats.dirs_freed++;
+}
+
 int user_map_pages(page_directory_t* udir, const paging_ctx_t* ctx,
                    uintptr_t uva_start, size_t size, uint32_t flags)
 {
     uintptr_t start = uva_start & ~(PAGE_SIZE - 1);
     uintptr_t end   = (uva_start + size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
 
-    for (uintptr_t va = start; va < end; va += PAGE_SIZE) {
-        uintptr_t pa = pmm_alloc_frame();
-        if (!pa) return -1;
+    if (end <= start) return 0;
+
+    // com #PF armado os frames só vêm no primeiro acesso; sem espaço na
+    // tabela de regiões cai no mapeamento imediato
+    if (page_fault_enabled() &&
+        vm_region_add(udir, start, end - start, flags | PAGE_USER, PAGE_TYPE_USER) == 0) {
+        return 0;
+    }
 
-        // zera frame via kmap (boa prática)
-        void* p = (page_table_t*)kmap(pa);
-        kmemset(p, 0, PAGE_SIZE);
-        kunmap();
+    phys_addr_t frames[PAGING_MAP_BATCH];
 
-        if (paging_map(udir, ctx, va, pa, flags | PAGE_USER | PAGE_PRESENT) != 0) {
-            // (ideal: liberar pa e desfazer mappings anteriores)
+    for (uintptr_t va = start; va < end; ) {
+        size_t want = (size_t)((end - va) / PAGE_SIZE);
+        if (want > PAGING_MAP_BATCH) want = PAGING_MAP_BATCH;
+
+        size_t got = pmm_alloc_zeroed_frames_for_va(frames, want, va);
+        for (size_t i = 0; i < got; ++i) {
+            page_set_type(frames[i], PAGE_TYPE_USER);
+        }
+
+        if (got < want ||
+            paging_map_range(udir, ctx, va, frames, got, flags | PAGE_USER | PAGE_PRESENT) != 0) {
+            for (size_t i = 0; i < got; ++i) {
+                pmm_free_frame(frames[i]);
+            }
+            // desfaz os lotes já mapeados (e as PTs que ficarem vazias)
+            paging_unmap_release(udir, ctx, start, (size_t)((va - start) / PAGE_SIZE));
             return -1;
         }
+        va += (uintptr_t)got * PAGE_SIZE;
     }
     return 0;
 }
+
+/**
+ * Mostra as páginas grandes em uso e o que elas economizam: cada PDE
+ * grande dispensa uma PT de 4 KiB e ocupa uma única entrada de TLB onde
+ * seriam necessárias paging_large_size()/4 KiB. Em seguida, o custo de
+ * map/unmap: PTEs escritas e invalidações emitidas.
+ */
+void paging_print_stats(void)
+{
+    uint32_t per_large = (uint32_t)(paging_large_size() / PAGE_SIZE);
+    uint32_t live      = g_paging_stats.large_live;
+
+    kprintf("\npaging: paginas grandes %s",
+            g_paging_large ? "ligadas" : "desligadas");
+    if (g_paging_large) {
+        kprintf(" (%u KiB)", (unsigned)(paging_large_size() >> 10));
+        kprintf("\n  PDEs grandes: %u no boot, %u em runtime, %u divididas",
+                (unsigned)g_paging_stats.boot_large,
+                (unsigned)g_paging_stats.large_mapped,
+                (unsigned)g_paging_stats.splits);
+        kprintf("\n  PTs: %u criadas no boot, %u evitadas (%u KiB)",
+                (unsigned)g_paging_stats.boot_tables,
+                (unsigned)live, (unsigned)(live * (PAGE_SIZE / 1024u)));
+        kprintf("\n  TLB: uma varredura dessas regioes custa %u faltas (%u com 4 KiB)",
+                (unsigned)live, (unsigned)(live * per_large));
+    }
+
+    kprintf("\n  map/unmap: %u PTEs escritas, %u invlpg, %u recargas de CR3, %u flush global",
+            (unsigned)g_paging_stats.pte_writes,
+            (unsigned)g_paging_stats.invlpgs,
+            (unsigned)g_paging_stats.cr3_reloads,
+            (unsigned)g_paging_stats.global_flushes);
+    kprintf("\n  reclamacao: %u PTs vazias devolvidas, %u diretorios destruidos",
+            (unsigned)g_paging_stats.pt_freed, (unsigned)g_paging_stats.dirs_freed);
+    if (g_paging_stats.kernel_prealloc) {
+        kprintf("\n  high-half: %u PTs compartilhadas (%u KiB)",
+                (unsigned)g_paging_stats.kernel_prealloc,
+                (unsigned)(g_paging_stats.kernel_prealloc * (PAGE_SIZE / 1024u)));
+    }
+    if (g_paging_stats.cow_shared) {
+        kprintf("\n  COW: %u frames compartilhados, %u copiados, %u reaproveitados",
+                (unsigned)g_paging_stats.cow_shared,
+                (unsigned)g_paging_stats.cow_copies,
+                (unsigned)g_paging_stats.cow_reused);
+    }
+}
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 #include "../../config.h"
 #include "../mm.h"
 
@@ -11,6 +12,12 @@
 #define PT_ENTRIES 1024u
 #endif
 
+/* Operações em faixa: até este número de páginas a invalidar, um invlpg
+ * por página; acima dele, uma recarga de CR3 sai mais barata. */
+#ifndef PAGING_FLUSH_THRESHOLD
+#define PAGING_FLUSH_THRESHOLD 32u
+#endif
+
 /* Flags */
 #define PAGE_PRESENT   0x001
 #define PAGE_RW        0x002
@@ -19,24 +26,135 @@
 #define PAGE_NOCACHE   0x010
 #define PAGE_ACCESSED  0x020
 #define PAGE_DIRTY     0x040
-#define PAGE_4MB       0x080
+#define PAGE_4MB       0x080   /* PS: PDE de página grande (4 MiB; 2 MiB no PAE) */
 #define PAGE_GLOBAL    0x100
+#define PAGE_COW       0x200   /* AVL: só leitura por copy-on-write (era PAGE_RW) */
+#define PAGE_PAT       0x080   /* PTE de 4 KiB: bit PAT (mesmo bit do PS na PDE) */
+
+/* Tamanho da página grande em cada modo */
+#define PAGE_LARGE_SIZE_32   0x00400000u
+#define PAGE_LARGE_SIZE_PAE  0x00200000u
 
-/* Calcula o índice na PD e PT de acordo com o endereço de memória */
+/* Calcula o índice na PD e PT de acordo com o endereço de memória
+ * (paging clássico de 32 bits; com PAE use paging_pde_index/pte_index) */
 #define PD_INDEX(vaddr)   ((((uint32_t)(vaddr)) >> 22) & 0x3FFu)
 #define PG_INDEX(vaddr) ((((uint32_t)(vaddr)) >> 12) & 0x3FFu)
 
+/* PAE: PDPT de 4 entradas; PDs e PTs com 512 entradas de 64 bits.
+ * Os 4 PDs ficam lado a lado e são tratados como um único vetor de
+ * 2048 PDEs (2 MiB cada), o que mantém um índice por PDE como no
+ * modo de 32 bits. */
+#define PAE_PDPT_ENTRIES  4u
+#define PAE_PT_ENTRIES    512u
+#define PAE_PDE_ENTRIES   (PAE_PDPT_ENTRIES * PAE_PT_ENTRIES)
+
+/* Parte de endereço físico de uma entrada */
+#define PAGE_ADDR_MASK_32   0xFFFFF000ull
+#define PAGE_ADDR_MASK_PAE  0x000FFFFFFFFFF000ull
+
 typedef uint32_t page_entry_t;
 
 typedef struct page_table {
     page_entry_t entries[PT_ENTRIES];
 } page_table_t;
 
-/* Page Directory deve caber em 4KiB (1 frame) */
+/* Page Directory: no modo de 32 bits só a primeira página (pde[]) é
+ * alocada. Com PAE são 4 páginas de PDEs seguidas da PDPT, que é para
+ * onde o CR3 aponta. Use paging_directory_bytes() para o tamanho. */
 typedef struct page_directory {
-    uint32_t pde[PT_ENTRIES]; /* PDEs (PT phys + flags) */
+    union {
+        uint32_t pde[PT_ENTRIES];          /* 32 bits: 1024 PDEs de 4 MiB */
+        uint64_t pde64[PAE_PDE_ENTRIES];   /* PAE: 2048 PDEs de 2 MiB     */
+    };
+    uint64_t pdpt[PAE_PDPT_ENTRIES];       /* PAE: alinhada a 32 bytes    */
 } page_directory_t;
 
+/* Modo PAE ativo (decidido uma vez no boot por paging_pae_probe) */
+extern bool g_paging_pae;
+
+static inline bool paging_pae_enabled(void)
+{
+    return g_paging_pae;
+}
+
+/* PDEs grandes disponíveis (PAGING_PSE e, sem PAE, CPUID.PSE) */
+extern bool g_paging_large;
+
+static inline bool paging_large_enabled(void)
+{
+    return g_paging_large;
+}
+
+/* CR4.PGE ligado: PAGE_GLOBAL vale nas entradas do high-half */
+extern bool g_paging_global;
+
+/* Flag a somar nos mapeamentos do kernel (high-half, iguais em todo
+ * diretório); 0 se a CPU não tiver PGE */
+static inline uint32_t paging_kernel_global(void)
+{
+    return g_paging_global ? PAGE_GLOBAL : 0u;
+}
+
+/* Bytes cobertos por uma PDE (= página grande) e a ordem no PMM */
+static inline uintptr_t paging_large_size(void)
+{
+    return g_paging_pae ? PAGE_LARGE_SIZE_PAE : PAGE_LARGE_SIZE_32;
+}
+
+static inline unsigned paging_large_order(void)
+{
+    return g_paging_pae ? 9u : 10u;
+}
+
+/* Entradas por PT no modo atual */
+static inline uint32_t paging_pt_entries(void)
+{
+    return g_paging_pae ? PAE_PT_ENTRIES : PT_ENTRIES;
+}
+
+/* Índice do PDE (no vetor contínuo de PDs) e do PTE para um VA */
+static inline uint32_t paging_pde_index(uintptr_t vaddr)
+{
+    return g_paging_pae ? (uint32_t)(vaddr >> 21) : PD_INDEX(vaddr);
+}
+
+static inline uint32_t paging_pte_index(uintptr_t vaddr)
+{
+    return g_paging_pae ? (uint32_t)((vaddr >> 12) & (PAE_PT_ENTRIES - 1u))
+                        : PG_INDEX(vaddr);
+}
+
+static inline uint64_t paging_addr_mask(void)
+{
+    return g_paging_pae ? PAGE_ADDR_MASK_PAE : PAGE_ADDR_MASK_32;
+}
+
+/* Lê/escreve a entrada 'idx' de uma tabela (PD ou PT) no formato do
+ * modo atual. Em PAE a entrada tem 64 bits e é escrita em duas metades:
+ * ao ligar, a parte alta vai antes do bit P; ao desligar, depois. */
+static inline uint64_t paging_entry_get(const void *table, uint32_t idx)
+{
+    if (g_paging_pae) return ((const volatile uint64_t *)table)[idx];
+    return ((const volatile uint32_t *)table)[idx];
+}
+
+static inline void paging_entry_set(void *table, uint32_t idx, uint64_t value)
+{
+    if (!g_paging_pae) {
+        ((volatile uint32_t *)table)[idx] = (uint32_t)value;
+        return;
+    }
+
+    volatile uint32_t *half = (volatile uint32_t *)&((uint64_t *)table)[idx];
+    if (value & PAGE_PRESENT) {
+        half[1] = (uint32_t)(value >> 32);
+        half[0] = (uint32_t)value;
+    } else {
+        half[0] = (uint32_t)value;
+        half[1] = (uint32_t)(value >> 32);
+    }
+}
+
 typedef struct paging_ctx {
     // alocador para estruturas no bootstrap (normalmente boot_early_kalloc)
     uintptr_t (*alloc_page_aligned)(size_t bytes, size_t align);
@@ -57,6 +175,9 @@ typedef struct paging_ctx {
 
     // flags padrão para kernel pages (ex.: PAGE_RW)
     uint32_t kernel_page_flags;
+
+    // memória física coberta pelo physmap (limitada a PHYSMAP_MAX_SIZE)
+    uintptr_t physmap_size;
 } paging_ctx_t;
 
 /* diretórios globais */
@@ -66,29 +187,87 @@ extern page_directory_t* kernel_directory;
 
 void paging_load_directory(uint32_t phys);
 void paging_enable(void);
+/* Desliga o paging, liga CR4.PAE, carrega CR3 com a PDPT e religa.
+ * Deve ser chamada pelo alias identity (código executando em VA == PA). */
+void paging_enable_pae(uint32_t pdpt_phys);
 void paging_disable(void);
 void invalid_tlb(uintptr_t va);
 int paging_is_on(void);
 
-uintptr_t virt_to_phys_paging(uintptr_t virt);
+phys_addr_t virt_to_phys_paging(uintptr_t virt);
 
 uintptr_t virt_to_phys_kernel(uintptr_t va) ;
 
+/* Decide o modo de paging (PAE se compilado e anunciado pela CPU).
+ * Chamada antes de pmm_init(), que depende do limite de memória. */
+bool paging_pae_probe(void);
+
+/* Bytes de um page_directory_t no modo atual (4 KiB ou 16 KiB + PDPT) */
+size_t paging_directory_bytes(void);
+
 /* init minimal + kmap pronto */
 void paging_init_minimal(const paging_ctx_t* ctx);
 
-/* troca CR3 */
+/* troca CR3 (entradas globais do kernel continuam no TLB) */
 void paging_switch_directory(page_directory_t* dir, const paging_ctx_t* ctx);
 
-/* map/unmap genérico (cria PT sob demanda, usando kmap quando paging já estiver ON) */
+/* Esvazia o TLB inteiro, inclusive entradas globais (alterna CR4.PGE).
+ * Para os casos raros em que um mapeamento global muda em massa. */
+void paging_flush_tlb_global(void);
+
+/* map/unmap genérico (cria PT sob demanda; PTs são acessadas pelo physmap
+ * ou por um slot do kmap quando paging já estiver ON) */
 int  paging_map(page_directory_t* dir, const paging_ctx_t* ctx,
-                uintptr_t virt, uintptr_t phys, uint32_t flags);
+                uintptr_t virt, phys_addr_t phys, uint32_t flags);
 
 int  paging_unmap(page_directory_t* dir, const paging_ctx_t* ctx,
                   uintptr_t virt);
 
-uintptr_t paging_get_physical(page_directory_t* dir, const paging_ctx_t* ctx,
-                              uintptr_t virt);
+/* Mapeia 'npages' páginas a partir de 'virt', visitando cada PT uma vez e
+ * agrupando as invalidações de TLB (só entradas que já eram presentes
+ * precisam delas). A página i vai para frames[i]; na versão _contig, para
+ * phys + i * PAGE_SIZE. Devolve -1 sem mapear nada se algum frame não for
+ * endereçável. */
+int  paging_map_range(page_directory_t* dir, const paging_ctx_t* ctx,
+                      uintptr_t virt, const phys_addr_t* frames,
+                      size_t npages, uint32_t flags);
+
+int  paging_map_range_contig(page_directory_t* dir, const paging_ctx_t* ctx,
+                             uintptr_t virt, phys_addr_t phys,
+                             size_t npages, uint32_t flags);
+
+/* Desfaz 'npages' mapeamentos a partir de 'virt'. PDEs grandes cobertas
+ * por inteiro são removidas sem dividir; frames não são liberados, mas
+ * PTs de usuário que ficarem sem entradas voltam ao PMM. */
+int  paging_unmap_range(page_directory_t* dir, const paging_ctx_t* ctx,
+                        uintptr_t virt, size_t npages);
+
+/* Mapeia uma página grande (paging_large_size()) numa PDE vazia.
+ * VA e PA precisam estar alinhados. Devolve -1 se não houver suporte ou
+ * se a PDE já apontar para uma PT; o chamador cai para páginas de 4 KiB.
+ * map/unmap de 4 KiB dentro de uma página grande a dividem numa PT. */
+int  paging_map_large(page_directory_t* dir, const paging_ctx_t* ctx,
+                      uintptr_t virt, phys_addr_t phys, uint32_t flags);
+
+/* true se a PDE de 'virt' aceita uma página grande (vazia ou já grande):
+ * o chamador consulta antes de pedir o bloco contíguo ao PMM */
+bool paging_large_slot_free(page_directory_t* dir, uintptr_t virt);
+
+phys_addr_t paging_get_physical(page_directory_t* dir, const paging_ctx_t* ctx,
+                                uintptr_t virt);
+
+/* Copia para 'dir' a PDE do kernel_directory que cobre 'virt' (high-half),
+ * se ela existir lá e faltar em 'dir'. Devolve 1 se copiou. Diretórios
+ * de usuário copiam o high-half só na criação; PTs novas do kernel chegam
+ * a eles por aqui. */
+int paging_sync_kernel_pde(page_directory_t* dir, uintptr_t virt);
+
+/* Aloca (no boot) uma PT para cada PDE vazia do high-half do kernel,
+ * menos as de [skip_start, skip_end), para que os diretórios de usuário
+ * compartilhem todas elas. Chamada por memory_setup() com
+ * PAGING_KERNEL_PREALLOC. */
+void paging_prealloc_kernel_tables(const paging_ctx_t* ctx,
+                                   uintptr_t skip_start, uintptr_t skip_end);
 
 /* criação de diretório (para userland também) */
 page_directory_t* paging_create_directory(const paging_ctx_t* ctx);
@@ -97,6 +276,34 @@ page_directory_t* paging_create_directory(const paging_ctx_t* ctx);
 page_directory_t* paging_create_user_directory_from_kernel(const paging_ctx_t* ctx,
                                                            const page_directory_t* kdir);
 
+/* Clona a metade de usuário de 'src' em copy-on-write: os frames passam
+ * a ser compartilhados só para leitura (com uma referência a mais cada)
+ * e só a página escrita é copiada depois. NULL se 'src' for o diretório
+ * do kernel ou faltar espaço nas tabelas de regiões. */
+page_directory_t* paging_clone_directory_cow(const paging_ctx_t* ctx, page_directory_t* src);
+
+/* Escrita numa PTE com PAGE_COW: copia o frame (ou, se este diretório é o
+ * último dono, só devolve PAGE_RW). 1 resolvida, 0 se a PTE não é COW,
+ * -1 sem memória. Chamada pelo tratador de #PF. */
+int paging_cow_fault(page_directory_t* dir, const paging_ctx_t* ctx,
+                     uintptr_t virt, bool user);
+
+/* Desfaz 'npages' mapeamentos a partir de 'virt' e solta uma referência
+ * de cada frame do PMM (page_put). PTs de usuário que ficarem vazias
+ * voltam ao PMM. */
+int paging_unmap_release(page_directory_t* dir, const paging_ctx_t* ctx,
+                         uintptr_t virt, size_t npages);
+
+/* Libera um diretório de usuário: frames da metade de usuário (uma
+ * referência por PTE), suas PTs, regiões sob demanda e o próprio
+ * diretório. Se for o diretório ativo, troca antes para o do kernel. */
+void paging_destroy_directory(page_directory_t* dir);
+
+#ifdef PAGING_COW_BENCH
+/* Compara clone COW com cópia ansiosa de um espaço populado (paging_bench.c) */
+void paging_cow_bench(void);
+#endif
+
 int user_map_pages(page_directory_t* udir, 
                     const paging_ctx_t* ctx,
                    uintptr_t uva_start, 
@@ -104,4 +311,8 @@ int user_map_pages(page_directory_t* udir,
 
 paging_ctx_t *get_paging_ctx(void);
 
+/* Páginas grandes em uso, page tables que elas evitaram e contadores de
+ * PTEs escritas / invalidações de TLB */
+void paging_print_stats(void);
+
 #endif
@@ -0,0 +1,154 @@
+/* paging_bench.c - Medições de boot do paging
+ *
+ * Compilado apenas com -DPAGING_COW_BENCH. kernel_main() chama
+ * paging_cow_bench() depois do page_fault_init().
+ */
+
+#include "paging.h"
+#include "paging_kmap.h"
+#include "../pmm.h"
+#include "../../klib/kprintf.h"
+#include "../../cpu/cpu.h"
+
+#ifdef PAGING_COW_BENCH
+
+/* Espaço populado (MiB) e VA de usuário onde ele é mapeado */
+#ifndef PAGING_COW_BENCH_MB
+#define PAGING_COW_BENCH_MB    64u
+#endif
+
+#define PAGING_COW_BENCH_VA    0x10000000u
+
+/* Depois do clone, escreve em 1 de cada TOUCH páginas do filho */
+#define PAGING_COW_BENCH_TOUCH 16u
+
+/* Frames alocados/mapeados por vez na população do pai */
+#define PAGING_COW_BENCH_BATCH 64u
+
+static phys_addr_t g_cow_batch[PAGING_COW_BENCH_BATCH];
+
+static uint32_t bench_cycles32(uint64_t cycles)
+{
+    return (cycles >> 32) ? 0xFFFFFFFFu : (uint32_t)cycles;
+}
+
+/* Popula 'pages' páginas de 'dir' a partir do VA da medição */
+static bool bench_populate(page_directory_t *dir, size_t pages)
+{
+    paging_ctx_t *ctx = get_paging_ctx();
+
+    for (size_t done = 0; done < pages; ) {
+        size_t want = pages - done;
+        if (want > PAGING_COW_BENCH_BATCH) want = PAGING_COW_BENCH_BATCH;
+
+        size_t got = pmm_alloc_frames_bulk(g_cow_batch, want);
+        for (size_t i = 0; i < got; ++i) page_set_type(g_cow_batch[i], PAGE_TYPE_USER);
+
+        uintptr_t va = PAGING_COW_BENCH_VA + (uintptr_t)done * PAGE_SIZE;
+        if (got < want ||
+            paging_map_range(dir, ctx, va, g_cow_batch, got, PAGE_RW | PAGE_USER) != 0) {
+            for (size_t i = 0; i < got; ++i) pmm_free_frame(g_cow_batch[i]);
+            return false;
+        }
+        done += got;
+    }
+    return true;
+}
+
+/* Cópia ansiosa: um frame novo por página, copiado pelos slots do kmap */
+static bool bench_eager_copy(page_directory_t *src, page_directory_t *dst, size_t pages)
+{
+    paging_ctx_t *ctx = get_paging_ctx();
+
+    for (size_t i = 0; i < pages; ++i) {
+        uintptr_t   va   = PAGING_COW_BENCH_VA + (uintptr_t)i * PAGE_SIZE;
+        phys_addr_t from = paging_get_physical(src, ctx, va);
+        phys_addr_t to   = pmm_alloc_frame_for_va(va);
+        if (!to) return false;
+
+        kmap_copy_frame(to, from);
+        page_set_type(to, PAGE_TYPE_USER);
+        if (paging_map(dst, ctx, va, to, PAGE_RW | PAGE_USER) != 0) {
+            pmm_free_frame(to);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void bench_report(const char *label, uint64_t cycles, size_t frames)
+{
+    kprintf("\n  %s: %u Kciclos, %u frames (%u KiB)", label,
+            (unsigned)(bench_cycles32(cycles) >> 10), (unsigned)frames,
+            (unsigned)(frames * (PAGE_SIZE / 1024u)));
+}
+
+/**
+ * Popula PAGING_COW_BENCH_MB MiB num diretório de usuário e compara
+ * duplicá-lo com cópia ansiosa e com paging_clone_directory_cow(): ciclos
+ * e frames consumidos. Depois escreve em parte do clone para medir o
+ * custo de cada falta COW. Reduz o tamanho se faltar memória.
+ */
+void paging_cow_bench(void)
+{
+    paging_ctx_t *ctx   = get_paging_ctx();
+    size_t        pages = (size_t)PAGING_COW_BENCH_MB * (MB_SIZE / PAGE_SIZE);
+    size_t        free0 = pmm_get_free_frame_count();
+
+    // pai + cópia ansiosa + PTs, com folga para o resto do kernel
+    if (free0 < 2u * pages + 2048u) {
+        pages = (free0 > 2048u) ? (free0 - 2048u) / 2u : 0;
+    }
+    kprintf("\npaging bench COW: %u MiB populados",
+            (unsigned)(pages / (MB_SIZE / PAGE_SIZE)));
+    if (pages == 0) return;
+
+    page_directory_t *parent = paging_create_user_directory_from_kernel(ctx, kernel_directory);
+    if (!bench_populate(parent, pages)) {
+        kprintf("\n  sem memoria para popular o pai");
+        paging_destroy_directory(parent);
+        return;
+    }
+
+    size_t   before = pmm_get_free_frame_count();
+    uint64_t t0     = cpu_rdtsc();
+    page_directory_t *eager = paging_create_user_directory_from_kernel(ctx, kernel_directory);
+    bool ok = bench_eager_copy(parent, eager, pages);
+    uint64_t eager_cycles = cpu_rdtsc() - t0;
+    size_t   eager_frames = before - pmm_get_free_frame_count();
+    paging_destroy_directory(eager);
+
+    if (!ok) kprintf("\n  copia ansiosa interrompida: sem memoria");
+    bench_report("copia ansiosa", eager_cycles, eager_frames);
+
+    before = pmm_get_free_frame_count();
+    t0     = cpu_rdtsc();
+    page_directory_t *child = paging_clone_directory_cow(ctx, parent);
+    uint64_t cow_cycles = cpu_rdtsc() - t0;
+    size_t   cow_frames = before - pmm_get_free_frame_count();
+
+    if (!child) {
+        kprintf("\n  clone COW falhou");
+        paging_destroy_directory(parent);
+        return;
+    }
+    bench_report("clone COW", cow_cycles, cow_frames);
+
+    // escrita no filho: cada página tocada gera uma falta e uma cópia
+    size_t touched = 0;
+    paging_switch_directory(child, ctx);
+    t0 = cpu_rdtsc();
+    for (size_t i = 0; i < pages; i += PAGING_COW_BENCH_TOUCH, ++touched) {
+        *(volatile uint32_t *)(PAGING_COW_BENCH_VA + (uintptr_t)i * PAGE_SIZE) = (uint32_t)i;
+    }
+    uint64_t touch_cycles = cpu_rdtsc() - t0;
+    paging_switch_directory(kernel_directory, ctx);
+
+    kprintf("\n  %u escritas no clone: %u ciclos por falta COW", (unsigned)touched,
+            (unsigned)(bench_cycles32(touch_cycles) / (touched ? touched : 1u)));
+
+    paging_destroy_directory(child);
+    paging_destroy_directory(parent);
+}
+
+#endif /* PAGING_COW_BENCH */
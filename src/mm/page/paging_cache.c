@@ -0,0 +1,184 @@
+/* paging_cache.c - Estoques de PTs e diretórios já zerados
+ *
+ * Criar um espaço de endereçamento ou a primeira página de uma faixa
+ * nova exige um diretório ou uma PT zerados. Em vez de limpar 4 KiB (ou
+ * 16 KiB + PDPT no PAE) no caminho da falta, cada tipo tem um estoque
+ * pequeno reposto pelo laço ocioso, com as mesmas marcas d'água do pool
+ * de frames zerados do PMM. PTs que ficam vazias já estão zeradas e
+ * voltam direto ao estoque.
+ */
+
+#include "paging_cache.h"
+#include "paging_kmap.h"
+#include "../pmm.h"
+#include "../../klib/memory.h"
+#include "../../klib/kprintf.h"
+#include "../../cpu/cpu.h"
+
+typedef struct {
+    phys_addr_t          blocks[PAGING_CACHE_TABLE_HIGH];
+    size_t               count;
+    size_t               low;
+    size_t               high;
+    bool                 refilling;     // começa vazio: repor até high
+    paging_cache_stats_t stats;
+} paging_cache_t;
+
+_Static_assert(PAGING_CACHE_DIR_HIGH <= PAGING_CACHE_TABLE_HIGH,
+               "estoque de diretorios maior que o vetor");
+
+static paging_cache_t g_caches[PAGING_CACHE_KINDS] = {
+    [PAGING_CACHE_TABLE] = { .low = PAGING_CACHE_TABLE_LOW, .high = PAGING_CACHE_TABLE_HIGH,
+                             .refilling = true },
+    [PAGING_CACHE_DIR]   = { .low = PAGING_CACHE_DIR_LOW,   .high = PAGING_CACHE_DIR_HIGH,
+                             .refilling = true },
+};
+
+static const char* const g_cache_names[PAGING_CACHE_KINDS] = { "PTs", "diretorios" };
+
+static size_t cache_block_bytes(paging_cache_kind_t kind)
+{
+    if (kind == PAGING_CACHE_DIR) {
+        return ALIGN_UP(paging_directory_bytes(), PAGE_SIZE);
+    }
+    return PAGE_SIZE;
+}
+
+static void cache_block_release(paging_cache_kind_t kind, phys_addr_t phys)
+{
+    if (kind == PAGING_CACHE_DIR) {
+        pmm_free_contig(phys, cache_block_bytes(kind));
+    } else {
+        pmm_free_frame(phys);
+    }
+}
+
+/* Bloco novo do PMM, zerado pelo physmap (0 se não houver) */
+static phys_addr_t cache_block_new(paging_cache_kind_t kind)
+{
+    size_t      bytes = cache_block_bytes(kind);
+    phys_addr_t phys  = (kind == PAGING_CACHE_DIR)
+                      ? pmm_alloc_contig(bytes, PAGE_SIZE, 0, PMM_ZONE_IDENTITY_LIMIT)
+                      : pmm_alloc_frames_zone(0, ZONE_IDENTITY);
+    if (!phys) return 0;
+
+    uintptr_t va = physmap_va(phys);
+    if (!va || !physmap_va(phys + bytes - 1u)) {
+        cache_block_release(kind, phys);
+        return 0;
+    }
+
+    kmemzero((void*)va, bytes);
+    for (size_t off = 0; off < bytes; off += PAGE_SIZE) {
+        page_set_type(phys + off, PAGE_TYPE_PAGETABLE);
+    }
+    return phys;
+}
+
+static phys_addr_t cache_pop(paging_cache_t* c)
+{
+    phys_addr_t phys  = 0;
+    uint32_t    flags = cpu_irq_save();
+
+    if (c->count > 0) {
+        phys = c->blocks[--c->count];
+        if (c->count < c->low) c->refilling = true;
+    }
+
+    cpu_irq_restore(flags);
+    return phys;
+}
+
+/* Guarda 'phys' se houver espaço; devolve false se o estoque está cheio */
+static bool cache_push(paging_cache_t* c, phys_addr_t phys)
+{
+    bool     ok    = false;
+    uint32_t flags = cpu_irq_save();
+
+    if (c->count < c->high) {
+        c->blocks[c->count++] = phys;
+        if (c->count >= c->high) c->refilling = false;
+        ok = true;
+    }
+
+    cpu_irq_restore(flags);
+    return ok;
+}
+
+phys_addr_t paging_cache_alloc(paging_cache_kind_t kind)
+{
+    if (kind >= PAGING_CACHE_KINDS) return 0;
+    paging_cache_t* c = &g_caches[kind];
+
+    phys_addr_t phys = cache_pop(c);
+    if (phys) {
+        c->stats.hits++;
+        return phys;
+    }
+
+    phys = cache_block_new(kind);
+    if (phys) c->stats.misses++;
+    return phys;
+}
+
+void paging_cache_free(paging_cache_kind_t kind, phys_addr_t phys, bool zeroed)
+{
+    if (kind >= PAGING_CACHE_KINDS || !phys) return;
+    paging_cache_t* c = &g_caches[kind];
+
+    if (zeroed && cache_push(c, phys)) {
+        c->stats.recycled++;
+        return;
+    }
+    cache_block_release(kind, phys);
+}
+
+/**
+ * Repõe os estoques abaixo da marca baixa (PTs primeiro) com até
+ * 'budget' blocos. Chamado do laço ocioso; 0 = nada a fazer.
+ */
+size_t paging_cache_refill(size_t budget)
+{
+    size_t done = 0;
+
+    for (uint32_t k = 0; k < PAGING_CACHE_KINDS; ++k) {
+        paging_cache_t* c = &g_caches[k];
+
+        while (done < budget && c->refilling) {
+            phys_addr_t phys = cache_block_new((paging_cache_kind_t)k);
+            if (!phys) {
+                c->refilling = false;   // sem memória: tenta no próximo low
+                break;
+            }
+            if (!cache_push(c, phys)) {
+                cache_block_release((paging_cache_kind_t)k, phys);
+                break;
+            }
+            c->stats.refilled++;
+            done++;
+        }
+    }
+    return done;
+}
+
+void paging_cache_get_stats(paging_cache_kind_t kind, paging_cache_stats_t* out)
+{
+    if (!out || kind >= PAGING_CACHE_KINDS) return;
+    *out       = g_caches[kind].stats;
+    out->count = g_caches[kind].count;
+}
+
+void paging_cache_print_stats(void)
+{
+    for (uint32_t k = 0; k < PAGING_CACHE_KINDS; ++k) {
+        const paging_cache_t* c = &g_caches[k];
+        size_t total = c->stats.hits + c->stats.misses;
+
+        kprintf("\npaging cache %s: %u/%u blocos, hits=%u misses=%u (%u%% acerto)"
+                " repostos=%u reciclados=%u",
+                g_cache_names[k], (unsigned)c->count, (unsigned)c->high,
+                (unsigned)c->stats.hits, (unsigned)c->stats.misses,
+                (unsigned)(total ? c->stats.hits * 100u / total : 0u),
+                (unsigned)c->stats.refilled, (unsigned)c->stats.recycled);
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef PAGING_CACHE_H
+#define PAGING_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "paging.h"
+
+/* Estoques de blocos já zerados para as estruturas de paging, repostos
+ * pelo laço ocioso (como o pool de frames zerados do PMM). Os blocos
+ * ficam abaixo de 64 MiB e são acessados pelo physmap. */
+typedef enum paging_cache_kind {
+    PAGING_CACHE_TABLE = 0,     /* page table: 1 frame                     */
+    PAGING_CACHE_DIR,           /* diretório: paging_directory_bytes()     */
+    PAGING_CACHE_KINDS
+} paging_cache_kind_t;
+
+/* Marcas d'água (em blocos) de cada estoque */
+#ifndef PAGING_CACHE_TABLE_LOW
+#define PAGING_CACHE_TABLE_LOW   4u
+#endif
+
+#ifndef PAGING_CACHE_TABLE_HIGH
+#define PAGING_CACHE_TABLE_HIGH  16u
+#endif
+
+#ifndef PAGING_CACHE_DIR_LOW
+#define PAGING_CACHE_DIR_LOW     1u
+#endif
+
+#ifndef PAGING_CACHE_DIR_HIGH
+#define PAGING_CACHE_DIR_HIGH    4u
+#endif
+
+/* Blocos zerados por passada do laço ocioso */
+#ifndef PAGING_CACHE_IDLE_BATCH
+#define PAGING_CACHE_IDLE_BATCH  2u
+#endif
+
+typedef struct {
+    size_t count;       // blocos no estoque
+    size_t hits;        // pedidos servidos pelo estoque
+    size_t misses;      // pedidos zerados na hora
+    size_t refilled;    // blocos zerados pelo laço ocioso
+    size_t recycled;    // blocos devolvidos já zerados (PTs vazias)
+} paging_cache_stats_t;
+
+/* Bloco zerado do tipo pedido, com os frames marcados como
+ * PAGE_TYPE_PAGETABLE. 0 sem memória abaixo de 64 MiB. */
+phys_addr_t paging_cache_alloc(paging_cache_kind_t kind);
+
+/* Devolve um bloco. Se 'zeroed' (ex.: PT sem nenhuma entrada) e houver
+ * espaço, volta ao estoque sem ser limpo; senão, ao PMM. */
+void paging_cache_free(paging_cache_kind_t kind, phys_addr_t phys, bool zeroed);
+
+/* Repõe até 'budget' blocos; retorna quantos foram zerados */
+size_t paging_cache_refill(size_t budget);
+
+void paging_cache_get_stats(paging_cache_kind_t kind, paging_cache_stats_t* out);
+void paging_cache_print_stats(void);
+
+#endif
@@ -3,9 +3,14 @@
 #include "../../klib/memory.h"
 #include "../../klib/kprintf.h"
 #include "../../klib/panic.h"
+#include "../../cpu/cpu.h"
 
-/* Essa PT é acessível por ponteiro normal (alocada no bootstrap identity) */
-static page_table_t* g_kmap_pt = NULL;
+/* Essa PT é acessível por ponteiro normal (alocada no bootstrap identity).
+ * O formato das entradas (32 ou 64 bits) segue o modo de paging. */
+static void* g_kmap_pt = NULL;
+
+/* Bytes do physmap já mapeados (0 até o paging_init_minimal terminar) */
+uintptr_t g_physmap_size = 0;
 
 /* Inicializa a page table do KMAP:
  * - aloca uma PT no bootstrap (identity)
@@ -18,15 +23,15 @@ void paging_kmap_init(page_directory_t* kdir, const paging_ctx_t* ctx)
 
     // aloca PT acessível no bootstrap (VA==PA ou ctx->virt_to_phys)
     uintptr_t pt_v = ctx->alloc_page_aligned(sizeof(page_table_t), PAGE_SIZE);
-    
+
     if (!pt_v) {
         panic("\npaging_kmap_init: Erro ao alocar memory!");
     }
 
-    g_kmap_pt = (page_table_t*)pt_v;
+    g_kmap_pt = (void*)pt_v;
     kmemset(g_kmap_pt, 0, sizeof(page_table_t));
 
-    uintptr_t pt_phys;
+    phys_addr_t pt_phys;
     if (ctx->virt_to_phys) {
         pt_phys = ctx->virt_to_phys(pt_v);
     }
@@ -35,32 +40,78 @@ void paging_kmap_init(page_directory_t* kdir, const paging_ctx_t* ctx)
     }
 
     //Calcula o índice em PD para o endereço KMAP_VA
-    uint32_t di = PD_INDEX(KMAP_VA);
+    uint32_t di = paging_pde_index(KMAP_VA);
 
     // Faz o PDE aponta para PT do KMAP
-    kdir->pde[di] = (uint32_t)((pt_phys & 0xFFFFF000u) | PAGE_PRESENT | PAGE_RW);
+    paging_entry_set(kdir->pde, di, (pt_phys & paging_addr_mask()) | PAGE_PRESENT | PAGE_RW);
+}
+
+/* VA do slot */
+static inline uintptr_t kmap_slot_va(kmap_slot_t slot)
+{
+    return KMAP_VA + (uintptr_t)slot * PAGE_SIZE;
+}
+
+/* Mapeia 'phys' no slot. Frames do physmap não ocupam o slot: o
+ * endereço linear é devolvido direto, sem invlpg. Com PAE aceita frames
+ * acima de 4 GiB. */
+uintptr_t kmap_atomic(phys_addr_t phys, kmap_slot_t slot)
+{
+    if (!g_kmap_pt || slot >= KMAP_SLOT_COUNT) for(;;);
+
+    phys &= paging_addr_mask();
+
+    uintptr_t va = physmap_va(phys);
+    if (va) return va;
+
+    va = kmap_slot_va(slot);
+    uint32_t ti = paging_pte_index(va);
+    paging_entry_set(g_kmap_pt, ti, phys | PAGE_PRESENT | PAGE_RW);
+
+    invalid_tlb(va);
+    return va;
 }
 
-/* Mapeia qualquer PA em KMAP_VA (1 página) */
-uintptr_t kmap(uintptr_t phys)
+/* Libera o slot. Se o último kmap_atomic caiu no physmap, a PTE já está
+ * vazia e não há nada a invalidar. */
+void kunmap_atomic(kmap_slot_t slot)
 {
-    if (!g_kmap_pt) for(;;);
+    if (!g_kmap_pt || slot >= KMAP_SLOT_COUNT) return;
+
+    uintptr_t va = kmap_slot_va(slot);
+    uint32_t ti = paging_pte_index(va);
+    if (!(paging_entry_get(g_kmap_pt, ti) & PAGE_PRESENT)) return;
 
-    phys &= 0xFFFFF000u;
+    paging_entry_set(g_kmap_pt, ti, 0);
+    invalid_tlb(va);
+}
 
-    uint32_t ti = PG_INDEX(KMAP_VA);
-    g_kmap_pt->entries[ti] = (uint32_t)(phys | PAGE_PRESENT | PAGE_RW);
-    
-    invalid_tlb(KMAP_VA);
-    return KMAP_VA;
+/* Mapeia qualquer PA (1 página) pelo slot de compatibilidade */
+uintptr_t kmap(phys_addr_t phys)
+{
+    return kmap_atomic(phys, KMAP_SLOT_LEGACY);
 }
 
 void kunmap(void)
 {
-    if (!g_kmap_pt) return;
+    kunmap_atomic(KMAP_SLOT_LEGACY);
+}
+
+/**
+ * Copia o frame 'src' para 'dst'. Os slots SRC/DST são exclusivos desta
+ * rotina, que roda com IRQs desabilitadas enquanto estiverem ocupados.
+ */
+void kmap_copy_frame(phys_addr_t dst, phys_addr_t src)
+{
+    uint32_t flags = cpu_irq_save();
+
+    void* d = (void*)kmap_atomic(dst, KMAP_SLOT_DST);
+    const void* s = (const void*)kmap_atomic(src, KMAP_SLOT_SRC);
+
+    kmemcpy(d, s, PAGE_SIZE);
+
+    kunmap_atomic(KMAP_SLOT_SRC);
+    kunmap_atomic(KMAP_SLOT_DST);
 
-    uint32_t ti = PG_INDEX(KMAP_VA);
-    g_kmap_pt->entries[ti] = 0;
-   
-    invalid_tlb(KMAP_VA);
+    cpu_irq_restore(flags);
 }
@@ -2,6 +2,7 @@
 #define PAGING_KMAP_H
 
 #include <stdint.h>
+#include "paging.h"
 
 // #define KERNEL_VIRT_BASE 0xC0000000u
 // #define KERNEL_PHYS_BASE 0x00100000u
@@ -16,10 +17,60 @@
 
 #define KMAP_VA 0xFFC00000u
 
+/* PHYSMAP: mapeamento linear e permanente da memória física baixa no
+ * high-half. Um frame em [0, physmap_size) é acessível em
+ * PHYSMAP_BASE + phys, sem remapear nem invalidar TLB. */
+#ifndef PHYSMAP_BASE
+#define PHYSMAP_BASE 0xE0000000u
+#endif
+
+#ifndef PHYSMAP_MAX_SIZE
+#define PHYSMAP_MAX_SIZE (128u * 1024u * 1024u)
+#endif
+
+/* Slots fixos do kmap a partir de KMAP_VA (uma página cada) para frames
+ * fora do physmap. Cada uso tem o seu slot, então dois frames podem
+ * ficar mapeados ao mesmo tempo (ex.: cópia entre frames). */
+typedef enum kmap_slot {
+    KMAP_SLOT_LEGACY = 0,   /* kmap()/kunmap() (= KMAP_VA)            */
+    KMAP_SLOT_PT,           /* page tables em paging_map/unmap/...    */
+    KMAP_SLOT_ZERO,         /* zerar frames (pool de frames zerados)  */
+    KMAP_SLOT_SRC,          /* origem de kmap_copy_frame              */
+    KMAP_SLOT_DST,          /* destino de kmap_copy_frame             */
+    KMAP_SLOT_COUNT
+} kmap_slot_t;
+
+/* Tamanho efetivo do physmap (definido no paging_init_minimal) */
+extern uintptr_t g_physmap_size;
+
 void     paging_kmap_init(page_directory_t* kdir, const paging_ctx_t* ctx);
-uintptr_t kmap(uintptr_t phys);
+
+/* Compatibilidade: slot único em KMAP_VA. Se o frame estiver no physmap
+ * devolve o endereço do physmap e não toca no slot. */
+uintptr_t kmap(phys_addr_t phys);
 void     kunmap(void);
 
+/* Mapeia 'phys' no slot indicado (ou devolve o endereço no physmap).
+ * O slot não é reentrante: quem pode ser interrompido por alguém que
+ * usa o mesmo slot deve desabilitar IRQs. */
+uintptr_t kmap_atomic(phys_addr_t phys, kmap_slot_t slot);
+void     kunmap_atomic(kmap_slot_t slot);
+
+/* Copia um frame inteiro (usa os slots SRC e DST) */
+void     kmap_copy_frame(phys_addr_t dst, phys_addr_t src);
+
+/* Endereço do frame no physmap, ou 0 se estiver fora dele */
+static inline uintptr_t physmap_va(phys_addr_t phys)
+{
+    if (phys >= (phys_addr_t)g_physmap_size) return 0;
+    return PHYSMAP_BASE + (uintptr_t)phys;
+}
+
+static inline bool physmap_contains_va(uintptr_t va)
+{
+    return va >= PHYSMAP_BASE && va - PHYSMAP_BASE < g_physmap_size;
+}
+
 static inline uintptr_t virt_to_phys_highhalf(uintptr_t virt)
 {
     if (virt < KERNEL_VIRT_BASE) {
@@ -6,6 +6,7 @@ section .text
 
 global paging_load_directory
 global paging_enable
+global paging_enable_pae
 global invalid_tlb
 
 
@@ -33,6 +34,33 @@ paging_disable:
     ret
 
 
+; Liga PAE: PG=0, CR4.PAE=1, CR3=PDPT, PG=1.
+; Precisa ser chamada pelo endereço identity (VA == PA) e não usa a
+; pilha com o paging desligado: a pilha do kernel está no high-half.
+; USO: void paging_enable_pae(uint32_t pdpt_phys);
+paging_enable_pae:
+    mov ecx, [esp + 4]   ; pdpt_phys (lido ainda com paging ligado)
+    pushfd
+    cli
+
+    mov eax, cr0
+    and eax, 0x7FFFFFFF  ; PG = 0
+    mov cr0, eax
+
+    mov eax, cr4
+    or  eax, 0x20        ; CR4.PAE (bit 5)
+    mov cr4, eax
+
+    mov cr3, ecx         ; PDPT (carrega as 4 PDPTEs)
+
+    mov eax, cr0
+    or  eax, 0x80000000  ; PG = 1
+    mov cr0, eax
+
+    popfd
+    ret                  ; volta ao chamador no high-half
+
+
 ;// invalida TLB apenas de uma página
 ; USO: void invalid_tlb(uintptr_t va);
 invalid_tlb:
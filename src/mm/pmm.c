@@ -1,4 +1,4 @@
-/* pmm.c - Implementação do Physical Memory Manager baseado em bitmap */
+/* pmm.c - Implementação do Physical Memory Manager (bitmap + buddy allocator) */
 
 #include "pmm.h"
 #include "bootmem.h"
@@ -6,6 +6,8 @@
 #include "../config.h"
 #include "./mm.h"
 #include "./page/paging.h"
+#include "../klib/panic.h"
+#include "../cpu/cpu.h"
 
 /* Bitmap global.
  * Cada bit representa um frame de FRAME_SIZE bytes.
@@ -22,19 +24,59 @@ static size_t g_pmm_free_frames    = 0;
 static size_t g_pmm_bitmap_words   = 0;  // quantidade de uint32_t efetivamente usados
 static size_t g_pmm_bitmap_size    = 0;  // em bytes (útil p/ pmm_bitmap_end_addr)
 
+/* Tamanho de toda a área de metadados (bitmap + buddy) em bytes */
+static size_t g_pmm_meta_size      = 0;
+
+/* Descritores por frame. Só existem depois de pmm_pages_init(); antes
+ * disso as rotinas de alocação não mexem neles. */
+static page_t *g_pmm_pages         = NULL;
+
+#if !PMM_BUDDY
+/* Resumo do bitmap: 1 bit por palavra do bitmap, ligado quando os 32
+ * frames daquela palavra estão usados. Permite pular 1024 frames
+ * ocupados testando uma única palavra. Só a busca sem buddy o lê. */
+static uint32_t *g_pmm_summary       = NULL;
+static size_t    g_pmm_summary_words = 0;
+#endif
+
+/* Zonas: faixas de frames [start, end) com contadores próprios */
+typedef struct {
+    size_t start;
+    size_t end;
+    size_t total;       // frames utilizáveis ao final do init
+    size_t free;
+#if !PMM_BUDDY
+    size_t hint_word;   // dica rotativa: palavra onde a última busca achou frame
+#endif
+} pmm_zone_info_t;
+
+static pmm_zone_info_t g_pmm_zones[PMM_ZONE_COUNT];
+
+static const char *const g_pmm_zone_names[PMM_ZONE_COUNT] = {
+    "DMA", "IDENTITY", "NORMAL", "HIGH"
+};
+
+/* Coloração: quantidade de cores (potência de 2) e modo ligado */
+static size_t g_pmm_colors         = 1;
+static bool   g_pmm_coloring       = PMM_COLORING;
+
+/* Fica true ao final do pmm_init(). A partir daí as rotinas mark_*
+ * mantêm o contador de livres e o buddy em sincronia. */
+static bool   g_pmm_ready          = false;
+
 
 /* -----------------------------------------------------------
  * Helpers
  * ----------------------------------------------------------- */
 
-static inline size_t pmm_addr_to_frame(uintptr_t addr)
+static inline size_t pmm_addr_to_frame(phys_addr_t addr)
 {
     return (size_t)(addr / FRAME_SIZE);
 }
 
-static inline uintptr_t pmm_frame_to_addr(size_t frame_idx)
+static inline phys_addr_t pmm_frame_to_addr(size_t frame_idx)
 {
-    return (uintptr_t)(frame_idx * (size_t)FRAME_SIZE);
+    return (phys_addr_t)frame_idx * FRAME_SIZE;
 }
 
 static void pmm_mask_invalid_tail_bits(void)
@@ -46,25 +88,531 @@ static void pmm_mask_invalid_tail_bits(void)
     g_pmm_bitmap[g_pmm_bitmap_words - 1] |= invalid_mask; // força inválidos como usados
 }
 
-/**
- * Calcula o tamanho em byte do espaço necessário para acomodar um bitmap suficiente
- * para controlar o tamanho de memória informada. Normalmente, o bitmap será criado
- * para acomodar toda a memória identificada pelo e820.
- */
-
-size_t pmm_calc_bitmap_size_bytes(uint64_t phys_mem_size)
+/* Quantidade de frames controlados para o tamanho de memória informado */
+static size_t pmm_frames_for(uint64_t phys_mem_size)
 {
     uint64_t frames64 = 0;
 
     if (phys_mem_size > 0) {
         frames64 = (phys_mem_size + (uint64_t)FRAME_SIZE - 1) / (uint64_t)FRAME_SIZE;
     }
-
     if (frames64 > (uint64_t)MAX_FRAMES) {
         frames64 = (uint64_t)MAX_FRAMES;
     }
+    return (size_t)frames64;
+}
+
+#if !PMM_BUDDY
+static inline size_t pmm_summary_words_for(size_t bitmap_words)
+{
+    return (bitmap_words + 31u) / 32u;
+}
+
+/* Atualiza o bit de resumo da palavra 'word' do bitmap */
+static inline void pmm_summary_update(size_t word)
+{
+    uint32_t bit = 1u << (word & 31u);
+
+    if (g_pmm_bitmap[word] == 0xFFFFFFFFu) {
+        g_pmm_summary[word >> 5] |= bit;
+    } else {
+        g_pmm_summary[word >> 5] &= ~bit;
+    }
+}
+
+/* Recalcula o resumo inteiro. Palavras além do bitmap contam como cheias. */
+static void pmm_summary_rebuild(void)
+{
+    for (size_t i = 0; i < g_pmm_summary_words; ++i) {
+        g_pmm_summary[i] = 0xFFFFFFFFu;
+    }
+    for (size_t w = 0; w < g_pmm_bitmap_words; ++w) {
+        pmm_summary_update(w);
+    }
+}
+#else
+/* Com o buddy a busca não passa pelo bitmap: não há resumo a manter */
+static inline void pmm_summary_update(size_t word) { (void)word; }
+#endif
+
+static inline void pmm_bitmap_set(size_t frame_idx)
+{
+    PMM_SET_BIT(g_pmm_bitmap, frame_idx);
+    pmm_summary_update(PMM_WORD_INDEX(frame_idx));
+}
+
+static inline void pmm_bitmap_clear(size_t frame_idx)
+{
+    PMM_CLEAR_BIT(g_pmm_bitmap, frame_idx);
+    pmm_summary_update(PMM_WORD_INDEX(frame_idx));
+}
+
+/* Conta bits ligados (sem depender de __popcountsi2 da libgcc) */
+static inline unsigned pmm_popcount32(uint32_t v)
+{
+    v = v - ((v >> 1) & 0x55555555u);
+    v = (v & 0x33333333u) + ((v >> 2) & 0x33333333u);
+    v = (v + (v >> 4)) & 0x0F0F0F0Fu;
+    return (v * 0x01010101u) >> 24;
+}
+
+/* Máscara dos bits [lo, hi) de uma palavra (0 <= lo < hi <= 32) */
+static inline uint32_t pmm_word_mask(unsigned lo, unsigned hi)
+{
+    uint32_t m = (hi >= 32u) ? 0xFFFFFFFFu : ((1u << hi) - 1u);
+    return m & (0xFFFFFFFFu << lo);
+}
+
+/* Percorre [first, first+count) palavra a palavra: as palavras parciais
+ * das pontas recebem máscara e as do meio são inteiras (0xFFFFFFFF).
+ * Uso:  for (pmm_word_iter_t it = pmm_word_iter(f, n); pmm_word_next(&it); ) */
+typedef struct {
+    size_t   cur;    // próximo frame
+    size_t   end;
+    size_t   word;   // palavra atual
+    uint32_t mask;   // bits da faixa dentro da palavra
+} pmm_word_iter_t;
+
+static inline pmm_word_iter_t pmm_word_iter(size_t first, size_t count)
+{
+    pmm_word_iter_t it = { first, first + count, 0, 0 };
+    return it;
+}
+
+static inline bool pmm_word_next(pmm_word_iter_t *it)
+{
+    if (it->cur >= it->end) return false;
+
+    size_t   base = it->cur & ~(size_t)31u;
+    unsigned lo   = (unsigned)(it->cur - base);
+    unsigned hi   = (it->end - base < 32u) ? (unsigned)(it->end - base) : 32u;
+
+    it->word = base >> 5;
+    it->mask = pmm_word_mask(lo, hi);
+    it->cur  = base + hi;
+    return true;
+}
+
+#if PMM_INIT_BITWISE
+/* Caminho antigo (um bit por iteração), mantido só para comparar o
+ * tempo de pmm_init() */
+static void pmm_bitmap_set_range(size_t first, size_t count)
+{
+    for (size_t f = first; f < first + count; ++f) {
+        pmm_bitmap_set(f);
+    }
+}
+
+static void pmm_bitmap_clear_range(size_t first, size_t count)
+{
+    for (size_t f = first; f < first + count; ++f) {
+        pmm_bitmap_clear(f);
+    }
+}
+#else
+static void pmm_bitmap_set_range(size_t first, size_t count)
+{
+    for (pmm_word_iter_t it = pmm_word_iter(first, count); pmm_word_next(&it); ) {
+        g_pmm_bitmap[it.word] |= it.mask;
+        pmm_summary_update(it.word);
+    }
+}
+
+static void pmm_bitmap_clear_range(size_t first, size_t count)
+{
+    for (pmm_word_iter_t it = pmm_word_iter(first, count); pmm_word_next(&it); ) {
+        g_pmm_bitmap[it.word] &= ~it.mask;
+        pmm_summary_update(it.word);
+    }
+}
+#endif
+
+#if !PMM_BUDDY
+/* Primeira palavra do bitmap em [from, to) com algum frame livre,
+ * consultando apenas o resumo. Retorna (size_t)-1 se não houver. */
+static size_t pmm_find_nonfull_word(size_t from, size_t to)
+{
+    size_t w = from;
+
+    while (w < to) {
+        uint32_t not_full = ~g_pmm_summary[w >> 5] & (0xFFFFFFFFu << (w & 31u));
+        if (not_full) {
+            size_t found = (w & ~(size_t)31u) | (size_t)__builtin_ctz(not_full);
+            return (found < to) ? found : (size_t)-1;
+        }
+        w = (w | 31u) + 1u;
+    }
+    return (size_t)-1;
+}
+#endif
+
+/* true se todos os frames de [first, first+count) estão marcados como usados */
+static bool pmm_bitmap_range_used(size_t first, size_t count)
+{
+    for (pmm_word_iter_t it = pmm_word_iter(first, count); pmm_word_next(&it); ) {
+        if ((g_pmm_bitmap[it.word] & it.mask) != it.mask) return false;
+    }
+    return true;
+}
+
+#if PMM_BUDDY
+/* -----------------------------------------------------------
+ * Buddy allocator
+ *
+ * Para cada ordem k (0..PMM_MAX_ORDER) existe um conjunto de bits com
+ * 1 bit por bloco de 2^k frames (alinhado ao próprio tamanho). Bit
+ * ligado = bloco livre e máximo (o buddy dele não está livre na mesma
+ * ordem). Cada conjunto é hierárquico: acima das folhas há níveis de
+ * resumo 32:1 (bit ligado = a palavra de baixo não é zero), então achar
+ * um bloco livre custa O(níveis) em vez de varrer o bitmap.
+ *
+ * O g_pmm_bitmap continua sendo a visão por frame (1 = usado) e é
+ * mantido em sincronia com o buddy.
+ * ----------------------------------------------------------- */
+
+/* 32^5 folhas = 32M blocos: sobra para MAX_FRAMES */
+#define PMM_HB_LEVELS 5u
+#define PMM_HB_NONE   ((size_t)-1)
+
+typedef struct {
+    uint32_t *lvl[PMM_HB_LEVELS];   // lvl[0] = folhas, lvl[n] = resumo de lvl[n-1]
+    size_t    words[PMM_HB_LEVELS];
+    unsigned  levels;
+} pmm_hbits_t;
+
+static pmm_hbits_t g_buddy_free[PMM_MAX_ORDER + 1];
+static size_t      g_buddy_blocks[PMM_MAX_ORDER + 1];  // blocos completos por ordem
+static size_t      g_buddy_nfree[PMM_MAX_ORDER + 1];   // blocos livres por ordem
 
-    size_t frames = (size_t)frames64;
+/* Distribui os níveis de um conjunto com 'bits' folhas a partir de 'mem'.
+ * Com hb/mem NULL apenas calcula. Retorna a quantidade de uint32_t usada.
+ */
+static size_t pmm_hb_layout(pmm_hbits_t *hb, size_t bits, uint32_t *mem)
+{
+    size_t   used = 0;
+    unsigned l    = 0;
+
+    do {
+        size_t words = (bits + 31u) / 32u;
+        if (words == 0) words = 1;
+
+        if (hb) {
+            hb->lvl[l]   = mem ? mem + used : NULL;
+            hb->words[l] = words;
+        }
+        used += words;
+        bits  = words;
+        l++;
+    } while (bits > 1 && l < PMM_HB_LEVELS);
+
+    if (hb) hb->levels = l;
+    return used;
+}
+
+static inline void pmm_hb_set(pmm_hbits_t *hb, size_t idx)
+{
+    for (unsigned l = 0; l < hb->levels; ++l) {
+        uint32_t *w = &hb->lvl[l][idx >> 5];
+        bool was_empty = (*w == 0);
+
+        *w |= 1u << (idx & 31u);
+        if (!was_empty) break;      // resumo acima já estava ligado
+        idx >>= 5;
+    }
+}
+
+static inline void pmm_hb_clear(pmm_hbits_t *hb, size_t idx)
+{
+    for (unsigned l = 0; l < hb->levels; ++l) {
+        uint32_t *w = &hb->lvl[l][idx >> 5];
+
+        *w &= ~(1u << (idx & 31u));
+        if (*w != 0) break;         // palavra ainda tem bits: resumo fica
+        idx >>= 5;
+    }
+}
+
+static inline bool pmm_hb_test(const pmm_hbits_t *hb, size_t idx)
+{
+    return ((hb->lvl[0][idx >> 5] >> (idx & 31u)) & 1u) != 0;
+}
+
+/* Primeiro bit ligado com índice >= from, ou PMM_HB_NONE. */
+static size_t pmm_hb_find_from(const pmm_hbits_t *hb, size_t from)
+{
+    size_t   idx = from;
+    unsigned l   = 0;
+
+    // sobe até achar um nível com bit ligado a partir da posição
+    for (;;) {
+        if (l >= hb->levels) return PMM_HB_NONE;
+
+        size_t w = idx >> 5;
+        if (w >= hb->words[l]) return PMM_HB_NONE;
+
+        uint32_t v = hb->lvl[l][w] & (0xFFFFFFFFu << (idx & 31u));
+        if (v) {
+            idx = (w << 5) | (size_t)__builtin_ctz(v);
+            break;
+        }
+        idx = w + 1;    // no nível de cima, o bit w+1 resume a palavra seguinte
+        l++;
+    }
+
+    // desce pelo primeiro bit de cada palavra
+    while (l > 0) {
+        l--;
+        idx = (idx << 5) | (size_t)__builtin_ctz(hb->lvl[l][idx]);
+    }
+    return idx;
+}
+
+static inline void pmm_buddy_insert(unsigned order, size_t block)
+{
+    pmm_hb_set(&g_buddy_free[order], block);
+    g_buddy_nfree[order]++;
+}
+
+static inline void pmm_buddy_remove(unsigned order, size_t block)
+{
+    pmm_hb_clear(&g_buddy_free[order], block);
+    g_buddy_nfree[order]--;
+}
+
+static inline bool pmm_buddy_is_free(unsigned order, size_t block)
+{
+    return block < g_buddy_blocks[order] && pmm_hb_test(&g_buddy_free[order], block);
+}
+
+/* Insere a faixa livre [first, end) como os maiores blocos alinhados possíveis */
+static void pmm_buddy_add_run(size_t first, size_t end)
+{
+    while (first < end) {
+        unsigned order = PMM_MAX_ORDER;
+        while (order > 0 &&
+               ((first & (((size_t)1 << order) - 1u)) != 0 ||
+                first + ((size_t)1 << order) > end)) {
+            order--;
+        }
+        pmm_buddy_insert(order, first >> order);
+        first += (size_t)1 << order;
+    }
+}
+
+/* Monta as listas do buddy a partir das faixas livres do bitmap */
+static void pmm_buddy_build(void)
+{
+    size_t f = 0;
+
+    while (f < g_pmm_total_frames) {
+        uint32_t w = g_pmm_bitmap[PMM_WORD_INDEX(f)];
+
+        if (PMM_BIT_OFFSET(f) == 0 && w == 0xFFFFFFFFu) {
+            f += 32u;
+            continue;
+        }
+        if (PMM_TEST_BIT(g_pmm_bitmap, f)) {
+            f++;
+            continue;
+        }
+
+        size_t start = f;
+        while (f < g_pmm_total_frames) {
+            if (PMM_BIT_OFFSET(f) == 0 && g_pmm_bitmap[PMM_WORD_INDEX(f)] == 0 &&
+                f + 32u <= g_pmm_total_frames) {
+                f += 32u;
+                continue;
+            }
+            if (PMM_TEST_BIT(g_pmm_bitmap, f)) break;
+            f++;
+        }
+        pmm_buddy_add_run(start, f);
+    }
+}
+
+/* Retira 'frame' do buddy, quebrando o bloco livre que o contém */
+static void pmm_buddy_reserve_frame(size_t frame)
+{
+    for (unsigned order = 0; order <= PMM_MAX_ORDER; ++order) {
+        size_t block = frame >> order;
+        if (!pmm_buddy_is_free(order, block)) continue;
+
+        pmm_buddy_remove(order, block);
+
+        // devolve as metades que não contêm o frame
+        while (order > 0) {
+            order--;
+            block = frame >> order;
+            pmm_buddy_insert(order, block ^ 1u);
+        }
+        return;
+    }
+}
+
+/* Retorna o primeiro frame de um bloco de 2^order contido em [lo, hi),
+ * ou PMM_HB_NONE. */
+static size_t pmm_buddy_alloc(unsigned order, size_t lo, size_t hi)
+{
+    for (unsigned k = order; k <= PMM_MAX_ORDER; ++k) {
+        if (g_buddy_nfree[k] == 0) continue;
+
+        size_t first = (lo + ((size_t)1 << k) - 1u) >> k;
+        size_t block = pmm_hb_find_from(&g_buddy_free[k], first);
+        if (block == PMM_HB_NONE || ((block + 1u) << k) > hi) continue;
+
+        pmm_buddy_remove(k, block);
+
+        // divide até a ordem pedida, devolvendo a metade de cima
+        while (k > order) {
+            k--;
+            block <<= 1;
+            pmm_buddy_insert(k, block | 1u);
+        }
+        return block << order;
+    }
+    return PMM_HB_NONE;
+}
+
+static void pmm_buddy_free(size_t frame, unsigned order)
+{
+    size_t block = frame >> order;
+
+    while (order < PMM_MAX_ORDER) {
+        size_t buddy = block ^ 1u;
+        if (!pmm_buddy_is_free(order, buddy)) break;
+
+        pmm_buddy_remove(order, buddy);
+        block >>= 1;
+        order++;
+    }
+    pmm_buddy_insert(order, block);
+}
+
+/* Devolve [first, end) ao buddy em blocos alinhados, unindo buddies */
+static void pmm_buddy_free_range(size_t first, size_t end)
+{
+    while (first < end) {
+        unsigned order = PMM_MAX_ORDER;
+        while (order > 0 &&
+               ((first & (((size_t)1 << order) - 1u)) != 0 ||
+                first + ((size_t)1 << order) > end)) {
+            order--;
+        }
+        pmm_buddy_free(first, order);
+        first += (size_t)1 << order;
+    }
+}
+#endif /* PMM_BUDDY */
+
+/* -----------------------------------------------------------
+ * Zonas e contadores
+ * ----------------------------------------------------------- */
+
+static void pmm_zones_setup(void)
+{
+    size_t limits[PMM_ZONE_COUNT] = {
+        (size_t)(PMM_ZONE_DMA_LIMIT / FRAME_SIZE),
+        (size_t)(PMM_ZONE_IDENTITY_LIMIT / FRAME_SIZE),
+        (size_t)(PMM_ZONE_NORMAL_LIMIT / FRAME_SIZE),
+        g_pmm_total_frames
+    };
+    size_t start = 0;
+
+    for (unsigned z = 0; z < PMM_ZONE_COUNT; ++z) {
+        size_t end = limits[z];
+        if (end > g_pmm_total_frames) end = g_pmm_total_frames;
+        if (end < start) end = start;
+
+        g_pmm_zones[z].start     = start;
+        g_pmm_zones[z].end       = end;
+        g_pmm_zones[z].total     = 0;
+        g_pmm_zones[z].free      = 0;
+#if !PMM_BUDDY
+        g_pmm_zones[z].hint_word = start / 32u;
+#endif
+        start = end;
+    }
+}
+
+/* Cores da L2 pela CPUID folha 4: tamanho / vias / FRAME_SIZE.
+ * Retorna 1 se a CPU não informar. */
+static size_t pmm_detect_colors(void)
+{
+    uint32_t max_leaf;
+    cpu_cpuid(0u, &max_leaf, NULL, NULL, NULL);
+    if (max_leaf < 4u) return 1;
+
+    for (uint32_t i = 0; i < 16u; ++i) {
+        uint32_t eax, ebx, ecx;
+        cpu_cpuid_count(4u, i, &eax, &ebx, &ecx, NULL);
+
+        uint32_t type  = eax & 0x1Fu;
+        uint32_t level = (eax >> 5) & 0x7u;
+        if (type == 0) break;                  // fim da lista
+        if (level != 2 || type == 1) continue; // só L2 de dados/unificada
+
+        uint32_t line       = (ebx & 0xFFFu) + 1u;
+        uint32_t partitions = ((ebx >> 12) & 0x3FFu) + 1u;
+        uint32_t sets       = ecx + 1u;
+
+        // tamanho / vias = line * partitions * sets
+        return (size_t)(line * partitions * sets / (uint32_t)FRAME_SIZE);
+    }
+    return 1;
+}
+
+static void pmm_colors_setup(void)
+{
+    size_t colors = PMM_COLORS ? PMM_COLORS : pmm_detect_colors();
+
+    // potência de 2, no máximo o maior bloco do buddy
+    size_t pow2 = 1;
+    while (pow2 * 2u <= colors && pow2 < ((size_t)1 << PMM_MAX_ORDER)) {
+        pow2 *= 2u;
+    }
+    g_pmm_colors = pow2;
+}
+
+/* Frames livres de [first, end) segundo o bitmap */
+static size_t pmm_count_free(size_t first, size_t end)
+{
+    if (end <= first) return 0;
+
+    size_t used = 0;
+    for (pmm_word_iter_t it = pmm_word_iter(first, end - first); pmm_word_next(&it); ) {
+        used += pmm_popcount32(g_pmm_bitmap[it.word] & it.mask);
+    }
+    return (end - first) - used;
+}
+
+/* Ajusta os contadores (global e por zona) para [first, first+count) */
+static void pmm_account(size_t first, size_t count, bool taken)
+{
+    size_t end = first + count;
+
+    for (unsigned z = 0; z < PMM_ZONE_COUNT; ++z) {
+        pmm_zone_info_t *zone = &g_pmm_zones[z];
+        size_t lo = (first > zone->start) ? first : zone->start;
+        size_t hi = (end < zone->end) ? end : zone->end;
+        if (lo >= hi) continue;
+
+        if (taken) zone->free -= hi - lo;
+        else       zone->free += hi - lo;
+    }
+
+    if (taken) g_pmm_free_frames -= count;
+    else       g_pmm_free_frames += count;
+}
+
+/**
+ * Calcula o tamanho em byte do espaço necessário para acomodar um bitmap suficiente
+ * para controlar o tamanho de memória informada. Normalmente, o bitmap será criado
+ * para acomodar toda a memória identificada pelo e820.
+ */
+
+size_t pmm_calc_bitmap_size_bytes(uint64_t phys_mem_size)
+{
+    size_t frames = pmm_frames_for(phys_mem_size);
     size_t words  = (frames + 31u) / 32u;
     size_t bytes  = words * sizeof(uint32_t);
 
@@ -81,6 +629,27 @@ size_t pmm_calc_bitmap_size_bytes(uint64_t phys_mem_size)
     return bytes;
 }
 
+/**
+ * Tamanho de todos os metadados do PMM: o bitmap e, com o buddy ativo, os
+ * conjuntos de blocos livres de cada ordem (cerca de 2 bits por frame);
+ * sem o buddy, o resumo do bitmap.
+ */
+size_t pmm_calc_meta_size_bytes(uint64_t phys_mem_size)
+{
+    size_t bytes = pmm_calc_bitmap_size_bytes(phys_mem_size);
+
+#if PMM_BUDDY
+    size_t frames = pmm_frames_for(phys_mem_size);
+    for (unsigned k = 0; k <= PMM_MAX_ORDER; ++k) {
+        bytes += pmm_hb_layout(NULL, frames >> k, NULL) * sizeof(uint32_t);
+    }
+#else
+    bytes += pmm_summary_words_for(bytes / sizeof(uint32_t)) * sizeof(uint32_t);
+#endif
+
+    return bytes;
+}
+
 
 /* 
  * Retorna o endereço físico imediatamente após o bitmap,
@@ -102,7 +671,7 @@ uintptr_t pmm_bitmap_end_addr(void)
         return 0; // ainda não inicializado
     }
 
-    uintptr_t bitmap_end = (uintptr_t)g_pmm_bitmap + g_pmm_bitmap_size;
+    uintptr_t bitmap_end = (uintptr_t)g_pmm_bitmap + g_pmm_meta_size;
     return ALIGN_UP(bitmap_end, FRAME_SIZE);
 }
 
@@ -135,8 +704,31 @@ void pmm_mark_region_used64(uint64_t base_phys, uint64_t length)
     size_t first = pmm_addr_to_frame64(base_phys);
     size_t last  = pmm_addr_to_frame64(end - 1);
 
-    for (size_t f = first; f <= last; ++f) {
-        PMM_SET_BIT(g_pmm_bitmap, f);
+    if (!g_pmm_ready) {
+        // boot: só o bitmap; os contadores são recalculados no fim do init
+        pmm_bitmap_set_range(first, last - first + 1u);
+        return;
+    }
+
+    // Depois do init: só os frames que mudam de estado mexem no buddy e
+    // nos contadores. Uma palavra nunca cruza duas zonas.
+    for (pmm_word_iter_t it = pmm_word_iter(first, last - first + 1u); pmm_word_next(&it); ) {
+        uint32_t changed = it.mask & ~g_pmm_bitmap[it.word];
+        if (!changed) continue;
+
+        size_t base = it.word * 32u;
+        pmm_account(base + (size_t)__builtin_ctz(changed), pmm_popcount32(changed), true);
+
+        for (uint32_t bits = changed; bits; bits &= bits - 1u) {
+            size_t f = base + (size_t)__builtin_ctz(bits);
+#if PMM_BUDDY
+            pmm_buddy_reserve_frame(f);
+#endif
+            if (g_pmm_pages) g_pmm_pages[f] = (page_t){ .type = PAGE_TYPE_RESERVED };
+        }
+
+        g_pmm_bitmap[it.word] |= changed;
+        pmm_summary_update(it.word);
     }
 }
 
@@ -154,8 +746,27 @@ void pmm_mark_region_free64(uint64_t base_phys, uint64_t length)
     size_t first = pmm_addr_to_frame64(base_phys);
     size_t last  = pmm_addr_to_frame64(end - 1);
 
-    for (size_t f = first; f <= last; ++f) {
-        PMM_CLEAR_BIT(g_pmm_bitmap, f);
+    if (!g_pmm_ready) {
+        pmm_bitmap_clear_range(first, last - first + 1u);
+        return;
+    }
+
+    for (pmm_word_iter_t it = pmm_word_iter(first, last - first + 1u); pmm_word_next(&it); ) {
+        uint32_t changed = it.mask & g_pmm_bitmap[it.word];
+        if (!changed) continue;
+
+        size_t base = it.word * 32u;
+        g_pmm_bitmap[it.word] &= ~changed;
+        pmm_summary_update(it.word);
+        pmm_account(base + (size_t)__builtin_ctz(changed), pmm_popcount32(changed), false);
+
+        for (uint32_t bits = changed; bits; bits &= bits - 1u) {
+            size_t f = base + (size_t)__builtin_ctz(bits);
+#if PMM_BUDDY
+            pmm_buddy_free(f, 0);
+#endif
+            if (g_pmm_pages) g_pmm_pages[f] = (page_t){ .type = PAGE_TYPE_FREE };
+        }
     }
 }
 
@@ -188,12 +799,16 @@ void pmm_mark_regions_status(void)
     // Se g_pmm_bitmap for VA (high-half), isso está errado.
     // Use g_pmm_bitmap_phys.
     pmm_mark_region_used64(g_pmm_bitmap_phys,
-                           (uint64_t)g_pmm_bitmap_size);
+                           (uint64_t)g_pmm_meta_size);
 }
 
 
 static void pmm_recalc_free_frames(void)
 {
+#if !PMM_INIT_BITWISE
+    // os bits inválidos do fim estão ligados; a máscara do iterador os ignora
+    g_pmm_free_frames = pmm_count_free(0, g_pmm_total_frames);
+#else
     size_t used = 0;
 
     for (size_t word = 0; word < g_pmm_bitmap_words; ++word) {
@@ -214,6 +829,7 @@ static void pmm_recalc_free_frames(void)
     }
 
     g_pmm_free_frames = g_pmm_total_frames - used;
+#endif
 }
 
 
@@ -231,98 +847,519 @@ void pmm_init(uint32_t *bitmap_ini, uint64_t phys_mem_size)
     //g_pmm_bitmap_phys = (uint64_t)(uintptr_t)bitmap_ini;
     g_pmm_bitmap_phys = (uint64_t)virt_to_phys_kernel((uintptr_t)bitmap_ini);
 
-    uint64_t frames64 = 0;
-    if (phys_mem_size > 0) {
-        frames64 = (phys_mem_size + (uint64_t)FRAME_SIZE - 1) / (uint64_t)FRAME_SIZE;
-    }
-    if (frames64 > (uint64_t)MAX_FRAMES) 
-        frames64 = (uint64_t)MAX_FRAMES;
+    g_pmm_ready        = false;
+    g_pmm_total_frames = pmm_frames_for(phys_mem_size);
+    g_pmm_bitmap_words = (g_pmm_total_frames + 31u) / 32u;
+    g_pmm_bitmap_size  = g_pmm_bitmap_words * sizeof(uint32_t);
+    g_pmm_meta_size    = pmm_calc_meta_size_bytes(phys_mem_size);
 
+    pmm_zones_setup();
+    pmm_colors_setup();
 
+#if PMM_BUDDY
+    // estruturas do buddy logo após o bitmap
+    uint32_t *meta = g_pmm_bitmap + g_pmm_bitmap_words;
+    for (unsigned k = 0; k <= PMM_MAX_ORDER; ++k) {
+        g_buddy_blocks[k] = g_pmm_total_frames >> k;
+        g_buddy_nfree[k]  = 0;
 
-    g_pmm_total_frames = (size_t)frames64;
-    g_pmm_bitmap_words = (g_pmm_total_frames + 31u) / 32u;
-    g_pmm_bitmap_size  = g_pmm_bitmap_words * sizeof(uint32_t);
+        size_t words = pmm_hb_layout(&g_buddy_free[k], g_buddy_blocks[k], meta);
+        for (size_t i = 0; i < words; ++i) meta[i] = 0u;
+        meta += words;
+    }
+#else
+    // resumo logo após o bitmap
+    g_pmm_summary       = g_pmm_bitmap + g_pmm_bitmap_words;
+    g_pmm_summary_words = pmm_summary_words_for(g_pmm_bitmap_words);
+#endif
 
     // Começa tudo usado
     for (size_t i = 0; i < g_pmm_bitmap_words; ++i)
         g_pmm_bitmap[i] = 0xFFFFFFFFu;
 
     pmm_mask_invalid_tail_bits();
+#if !PMM_BUDDY
+    pmm_summary_rebuild();
+#endif
 
     // Libera regiões USABLE e depois trava kernel/bitmap/etc
     pmm_mark_regions_status();
 
     // Recalcula (e NÃO mexa em g_pmm_free_frames dentro das mark_* enquanto usar recalc)
     pmm_recalc_free_frames();
+
+    for (unsigned z = 0; z < PMM_ZONE_COUNT; ++z) {
+        pmm_zone_info_t *zone = &g_pmm_zones[z];
+        zone->free  = pmm_count_free(zone->start, zone->end);
+        zone->total = zone->free;
+    }
+
+#if PMM_BUDDY
+    pmm_buddy_build();
+#endif
+
+    g_pmm_ready = true;
 }
 
 
-/**
- * Aloca um frame de memória e devolve o seu endereço físico.
- */
-uintptr_t pmm_alloc_frame(void)
+#if !PMM_BUDDY
+/* Primeiro frame livre da zona a partir da sua dica rotativa, dando a
+ * volta na zona. O resumo pula palavras cheias e o bit é achado com ctz. */
+static size_t pmm_bitmap_find_free(pmm_zone_info_t *zone)
 {
-    if (g_pmm_free_frames == 0 || g_pmm_total_frames == 0) {
-        return 0;
+    size_t first_word = zone->start / 32u;
+    size_t end_word   = (zone->end + 31u) / 32u;
+
+    size_t w = pmm_find_nonfull_word(zone->hint_word, end_word);
+    if (w == (size_t)-1) {
+        w = pmm_find_nonfull_word(first_word, zone->hint_word);
+    }
+    if (w == (size_t)-1) {
+        return (size_t)-1;
     }
 
-    for (size_t word = 0; word < g_pmm_bitmap_words; ++word) {
-        uint32_t value = g_pmm_bitmap[word];
+    zone->hint_word = w;
+    // bits inválidos do fim estão forçados como usados
+    return w * 32u + (size_t)__builtin_ctz(~g_pmm_bitmap[w]);
+}
+#endif
+
+/* Procura 'count' frames livres contíguos em [lo, hi), começando em
+ * múltiplo de 'align' e sem cruzar múltiplos de 'boundary' (0 = sem
+ * restrição). Varredura do bitmap: usada só para pedidos raros. */
+static size_t pmm_bitmap_find_run(size_t count, size_t align, size_t boundary,
+                                  size_t lo, size_t hi)
+{
+    size_t first = (lo + align - 1u) & ~(align - 1u);
 
-        if (value == 0xFFFFFFFFu) {
+    while (first + count <= hi) {
+        if (boundary && (first / boundary) != ((first + count - 1u) / boundary)) {
+            // pula para o próximo múltiplo de boundary (também alinhado)
+            first = (first + boundary - 1u) & ~(boundary - 1u);
+            first = (first + align - 1u) & ~(align - 1u);
             continue;
         }
 
-        for (uint32_t bit = 0; bit < 32u; ++bit) {
-            uint32_t mask = 1u << bit;
-            if (!(value & mask)) {
-                size_t frame_idx = word * 32u + bit;
+        size_t f = first;
+        while (f < first + count && !PMM_TEST_BIT(g_pmm_bitmap, f)) {
+            ++f;
+        }
+        if (f == first + count) {
+            return first;
+        }
 
-                // Segurança extra (idealmente não precisa se você mascarar bits inválidos na init)
-                if (frame_idx >= g_pmm_total_frames) {
-                    break; // não "return 0" aqui
-                }
+        // recomeça depois do frame ocupado
+        first = (f + 1u + align - 1u) & ~(align - 1u);
+    }
+    return (size_t)-1;
+}
 
-                PMM_SET_BIT(g_pmm_bitmap, frame_idx);
-                if (g_pmm_free_frames) --g_pmm_free_frames;
+/* Descritores de [first, first+count) recém-alocados: 1 referência */
+static inline void pmm_pages_init_alloc(size_t first, size_t count)
+{
+    if (!g_pmm_pages) return;
+    for (size_t f = first; f < first + count; ++f) {
+        g_pmm_pages[f] = (page_t){ .refcount = 1, .type = PAGE_TYPE_KERNEL };
+    }
+}
 
-                return (uintptr_t)frame_idx * (uintptr_t)FRAME_SIZE;
-            }
+/* Marca [first, first+count) como usado e desconta dos contadores */
+static inline void pmm_take(size_t first, size_t count)
+{
+    pmm_bitmap_set_range(first, count);
+    pmm_account(first, count, true);
+    pmm_pages_init_alloc(first, count);
+}
+
+/* Devolve [first, first+count) (já validado como usado) */
+static void pmm_release(size_t first, size_t count)
+{
+    if (g_pmm_pages) {
+        for (size_t f = first; f < first + count; ++f) {
+            g_pmm_pages[f] = (page_t){ .type = PAGE_TYPE_FREE };
         }
     }
 
+    pmm_bitmap_clear_range(first, count);
+    pmm_account(first, count, false);
+
+#if PMM_BUDDY
+    pmm_buddy_free_range(first, first + count);
+#endif
+}
+
+/**
+ * Aloca 2^order frames contíguos na zona indicada; se ela não tiver,
+ * tenta as zonas abaixo (HIGH -> NORMAL -> IDENTITY -> DMA). Com o buddy, o custo
+ * é O(log n) e não depende da ocupação da memória.
+ */
+phys_addr_t pmm_alloc_frames_zone(unsigned order, pmm_zone_t zone)
+{
+    if (order > PMM_MAX_ORDER || g_pmm_total_frames == 0 || zone >= PMM_ZONE_COUNT) {
+        return 0;
+    }
+
+    size_t count = (size_t)1 << order;
+    if (g_pmm_free_frames < count) {
+        return 0;
+    }
+
+    for (int z = (int)zone; z >= 0; --z) {
+        pmm_zone_info_t *zi = &g_pmm_zones[z];
+        if (zi->free < count) continue;
+
+#if PMM_BUDDY
+        size_t frame_idx = pmm_buddy_alloc(order, zi->start, zi->end);
+        if (frame_idx == PMM_HB_NONE) continue;
+#else
+        size_t frame_idx = (order == 0)
+            ? pmm_bitmap_find_free(zi)
+            : pmm_bitmap_find_run(count, count, 0, zi->start, zi->end);
+        if (frame_idx == (size_t)-1) continue;
+#endif
+
+        pmm_take(frame_idx, count);
+        return pmm_frame_to_addr(frame_idx);
+    }
+
     return 0;
 }
 
+phys_addr_t pmm_alloc_frames(unsigned order)
+{
+    return pmm_alloc_frames_zone(order, ZONE_HIGH);
+}
 
-void pmm_free_frame(uintptr_t frame_addr)
+void pmm_free_frames(phys_addr_t addr, unsigned order)
 {
-    if (g_pmm_total_frames == 0) return;
+    if (g_pmm_total_frames == 0 || order > PMM_MAX_ORDER) return;
 
-    // Exige alinhamento de página/frame
-    if (frame_addr & (FRAME_SIZE - 1)) {
+    // Exige alinhamento ao tamanho do bloco
+    if (addr & ((FRAME_SIZE << order) - 1)) {
         return; // ou log/panic
     }
 
     // Nunca libere frame 0
-    if (frame_addr == 0) {
+    if (addr == 0) {
         return;
     }
 
-    // (Opcional mas MUITO recomendado)
-    // if (frame_addr >= kernel_start && frame_addr < kernel_end) return;
-    // if (frame_addr >= bitmap_start && frame_addr < bitmap_end) return;
+    size_t frame_idx = pmm_addr_to_frame(addr);
+    size_t count     = (size_t)1 << order;
+    if (frame_idx + count > g_pmm_total_frames) {
+        return;
+    }
 
-    size_t frame_idx = (size_t)(frame_addr / FRAME_SIZE);
-    if (frame_idx >= g_pmm_total_frames) {
+    // Double free (ou ordem errada): não mexe em nada
+    if (!pmm_bitmap_range_used(frame_idx, count)) {
         return;
     }
 
-    if (PMM_TEST_BIT(g_pmm_bitmap, frame_idx)) {
-        PMM_CLEAR_BIT(g_pmm_bitmap, frame_idx);
-        ++g_pmm_free_frames;
+    // Frame compartilhado: quem tem referência deve usar page_put()
+    if (g_pmm_pages && g_pmm_pages[frame_idx].refcount > 1) {
+        panic("pmm_free_frames: frame compartilhado (refcount > 1)");
+    }
+
+    pmm_release(frame_idx, count);
+}
+
+/**
+ * Aloca 'size' bytes fisicamente contíguos para dispositivos:
+ *  - align    : alinhamento do início (potência de 2, mínimo FRAME_SIZE)
+ *  - boundary : o buffer não cruza múltiplos deste valor (0 = livre)
+ *  - max_phys : o buffer inteiro fica abaixo deste endereço (0 = livre)
+ * Retorna o endereço físico ou 0. Libere com pmm_free_contig().
+ */
+phys_addr_t pmm_alloc_contig(size_t size, size_t align, size_t boundary, uint64_t max_phys)
+{
+    if (size == 0 || g_pmm_total_frames == 0) return 0;
+
+    if (align < FRAME_SIZE) align = FRAME_SIZE;
+    if (!is_power_of_two(align)) return 0;
+    if (boundary && (!is_power_of_two(boundary) || boundary < FRAME_SIZE || size > boundary)) {
+        return 0;
+    }
+
+    size_t count = (size_t)((size + FRAME_SIZE - 1) / FRAME_SIZE);
+    if (g_pmm_free_frames < count) return 0;
+
+    size_t hi = g_pmm_total_frames;
+    if (max_phys && max_phys / FRAME_SIZE < (uint64_t)hi) {
+        hi = (size_t)(max_phys / FRAME_SIZE);
+    }
+
+    size_t align_frames    = (size_t)(align / FRAME_SIZE);
+    size_t boundary_frames = (size_t)(boundary / FRAME_SIZE);
+
+#if PMM_BUDDY
+    // Um bloco de 2^order >= max(count, align) já nasce alinhado e, como
+    // size <= boundary, não cruza o boundary. O excesso volta ao buddy.
+    size_t span = (count > align_frames) ? count : align_frames;
+    unsigned order = 0;
+    while (((size_t)1 << order) < span) order++;
+#endif
+
+    // mesma ordem de zonas das alocações comuns, respeitando max_phys
+    for (int z = PMM_ZONE_COUNT - 1; z >= 0; --z) {
+        pmm_zone_info_t *zi = &g_pmm_zones[z];
+        size_t lo   = (zi->start > 0) ? zi->start : 1;   // nunca o frame 0
+        size_t zend = (zi->end < hi) ? zi->end : hi;
+        if (lo >= zend || zi->free < count) continue;
+
+#if PMM_BUDDY
+        if (order <= PMM_MAX_ORDER) {
+            size_t frame_idx = pmm_buddy_alloc(order, lo, zend);
+            if (frame_idx != PMM_HB_NONE) {
+                size_t block = (size_t)1 << order;
+                pmm_take(frame_idx, count);
+                pmm_buddy_free_range(frame_idx + count, frame_idx + block);
+                return pmm_frame_to_addr(frame_idx);
+            }
+        }
+#endif
+
+        size_t frame_idx = pmm_bitmap_find_run(count, align_frames, boundary_frames, lo, zend);
+        if (frame_idx == (size_t)-1) continue;
+
+#if PMM_BUDDY
+        for (size_t f = frame_idx; f < frame_idx + count; ++f) {
+            pmm_buddy_reserve_frame(f);
+        }
+#endif
+        pmm_take(frame_idx, count);
+        return pmm_frame_to_addr(frame_idx);
+    }
+
+    return 0;
+}
+
+void pmm_free_contig(phys_addr_t addr, size_t size)
+{
+    if (g_pmm_total_frames == 0 || addr == 0 || size == 0) return;
+    if (addr & (FRAME_SIZE - 1)) return;
+
+    size_t frame_idx = pmm_addr_to_frame(addr);
+    size_t count     = (size_t)((size + FRAME_SIZE - 1) / FRAME_SIZE);
+    if (frame_idx + count > g_pmm_total_frames) return;
+
+    if (!pmm_bitmap_range_used(frame_idx, count)) return;
+
+    pmm_release(frame_idx, count);
+}
+
+/**
+ * Preenche 'out' com até 'n' frames (não necessariamente contíguos) numa
+ * única passada, em vez de n buscas independentes. Usa as zonas na mesma
+ * ordem de pmm_alloc_frames(). Retorna quantos frames foram obtidos:
+ * menos que 'n' apenas se a memória livre acabar.
+ */
+size_t pmm_alloc_frames_bulk(phys_addr_t *out, size_t n)
+{
+    if (!out || g_pmm_total_frames == 0) return 0;
+
+    if (n > g_pmm_free_frames) n = g_pmm_free_frames;
+
+    size_t got = 0;
+
+    for (int z = PMM_ZONE_COUNT - 1; z >= 0 && got < n; --z) {
+        pmm_zone_info_t *zi = &g_pmm_zones[z];
+
+#if PMM_BUDDY
+        // pega blocos grandes e os entrega frame a frame
+        while (got < n && zi->free > 0) {
+            size_t   want  = n - got;
+            unsigned order = 0;
+            while (order < PMM_MAX_ORDER && ((size_t)2 << order) <= want) {
+                order++;
+            }
+
+            size_t frame_idx = pmm_buddy_alloc(order, zi->start, zi->end);
+            while (frame_idx == PMM_HB_NONE && order > 0) {
+                frame_idx = pmm_buddy_alloc(--order, zi->start, zi->end);
+            }
+            if (frame_idx == PMM_HB_NONE) break;
+
+            size_t count = (size_t)1 << order;
+            pmm_take(frame_idx, count);
+            for (size_t i = 0; i < count; ++i) {
+                out[got++] = pmm_frame_to_addr(frame_idx + i);
+            }
+        }
+#else
+        // da dica até o fim da zona, depois do início da zona até a dica
+        size_t start = zi->hint_word;
+        size_t ranges[2][2] = {
+            { start, (zi->end + 31u) / 32u },
+            { zi->start / 32u, start }
+        };
+
+        for (int r = 0; r < 2 && got < n; ++r) {
+            size_t w = ranges[r][0];
+
+            while (got < n) {
+                w = pmm_find_nonfull_word(w, ranges[r][1]);
+                if (w == (size_t)-1) break;
+
+                uint32_t free_bits = ~g_pmm_bitmap[w];
+                size_t   taken     = 0;
+                while (free_bits && got < n) {
+                    uint32_t bit = (uint32_t)__builtin_ctz(free_bits);
+                    free_bits &= free_bits - 1u;
+
+                    g_pmm_bitmap[w] |= 1u << bit;
+                    pmm_pages_init_alloc(w * 32u + bit, 1);
+                    out[got++] = pmm_frame_to_addr(w * 32u + bit);
+                    taken++;
+                }
+                pmm_summary_update(w);
+                zi->free          -= taken;
+                g_pmm_free_frames -= taken;
+                zi->hint_word      = w;
+            }
+        }
+#endif
+    }
+
+    return got;
+}
+
+/* -----------------------------------------------------------
+ * Coloração de páginas
+ * ----------------------------------------------------------- */
+
+unsigned pmm_color_count(void)
+{
+    return (unsigned)g_pmm_colors;
+}
+
+unsigned pmm_frame_color(phys_addr_t phys)
+{
+    return (unsigned)(pmm_addr_to_frame(phys) & (g_pmm_colors - 1u));
+}
+
+unsigned pmm_va_color(uintptr_t va)
+{
+    return (unsigned)((va / PAGE_SIZE) & (g_pmm_colors - 1u));
+}
+
+void pmm_set_coloring(bool enabled)
+{
+    g_pmm_coloring = enabled;
+}
+
+bool pmm_coloring_enabled(void)
+{
+    return g_pmm_coloring && g_pmm_colors > 1;
+}
+
+#if PMM_BUDDY
+/* Frame livre da cor 'color' em [lo, hi). Começa pelos blocos pequenos
+ * (para não quebrar blocos grandes à toa); um bloco de 2^k >= cores
+ * contém todas as cores e resolve o pedido. */
+static size_t pmm_find_color_frame(size_t color, size_t lo, size_t hi)
+{
+    size_t cmask = g_pmm_colors - 1u;
+
+    for (unsigned k = 0; k <= PMM_MAX_ORDER; ++k) {
+        if (g_buddy_nfree[k] == 0) continue;
+
+        size_t   bsize = (size_t)1 << k;
+        size_t   block = pmm_hb_find_from(&g_buddy_free[k], (lo + bsize - 1u) >> k);
+        unsigned tries = (bsize >= g_pmm_colors) ? 1u : PMM_COLOR_SCAN;
+
+        while (block != PMM_HB_NONE && tries--) {
+            size_t first = block << k;
+            if (first + bsize > hi) break;
+
+            // o bloco cobre as cores [first & cmask, +bsize)
+            if (((first ^ color) & cmask & ~(bsize - 1u)) == 0) {
+                return first + (color & (bsize - 1u) & cmask);
+            }
+            block = pmm_hb_find_from(&g_buddy_free[k], block + 1u);
+        }
+    }
+    return (size_t)-1;
+}
+#else
+/* Frame livre da cor 'color' em [lo, hi), varrendo só as palavras do
+ * bitmap que contêm essa cor. */
+static size_t pmm_find_color_frame(size_t color, size_t lo, size_t hi)
+{
+    size_t cmask = g_pmm_colors - 1u;
+
+    // bits da palavra com a cor pedida (palavras com < 32 cores repetem o padrão)
+    uint32_t pattern = 0;
+    size_t   stride  = 1;
+    if (g_pmm_colors >= 32u) {
+        pattern = 1u << (color & 31u);
+        stride  = g_pmm_colors / 32u;
+    } else {
+        for (size_t b = color; b < 32u; b += g_pmm_colors) pattern |= 1u << b;
+    }
+
+    size_t w = lo / 32u;
+    if (g_pmm_colors >= 32u) {
+        // primeira palavra >= w que contém a cor
+        size_t want = (color & cmask) / 32u;
+        w = (w - (w % stride)) + want;
+        if (w < lo / 32u) w += stride;
+    }
+
+    for (; w * 32u < hi; w += stride) {
+        uint32_t free_bits = ~g_pmm_bitmap[w] & pattern;
+        while (free_bits) {
+            size_t f = w * 32u + (size_t)__builtin_ctz(free_bits);
+            if (f >= lo && f < hi) return f;
+            free_bits &= free_bits - 1u;
+        }
     }
+    return (size_t)-1;
+}
+#endif
+
+phys_addr_t pmm_alloc_frame_color(unsigned color)
+{
+    if (g_pmm_total_frames == 0 || g_pmm_free_frames == 0) return 0;
+
+    color &= (unsigned)(g_pmm_colors - 1u);
+
+    for (int z = PMM_ZONE_COUNT - 1; z >= 0; --z) {
+        pmm_zone_info_t *zi = &g_pmm_zones[z];
+        if (zi->free == 0) continue;
+
+        size_t lo = (zi->start > 0) ? zi->start : 1;   // nunca o frame 0
+        size_t f  = pmm_find_color_frame(color, lo, zi->end);
+        if (f == (size_t)-1) continue;
+
+#if PMM_BUDDY
+        pmm_buddy_reserve_frame(f);
+#endif
+        pmm_take(f, 1);
+        return pmm_frame_to_addr(f);
+    }
+
+    // nenhum frame dessa cor: qualquer um serve
+    return pmm_alloc_frame();
+}
+
+phys_addr_t pmm_alloc_frame_for_va(uintptr_t va)
+{
+    if (!pmm_coloring_enabled()) return pmm_alloc_frame();
+    return pmm_alloc_frame_color(pmm_va_color(va));
+}
+
+/**
+ * Aloca um frame de memória e devolve o seu endereço físico.
+ */
+phys_addr_t pmm_alloc_frame(void)
+{
+    return pmm_alloc_frames(0);
+}
+
+
+void pmm_free_frame(phys_addr_t frame_addr)
+{
+    pmm_free_frames(frame_addr, 0);
 }
 
 
@@ -330,3 +1367,122 @@ size_t pmm_get_free_frame_count(void)
 {
     return g_pmm_free_frames;
 }
+
+
+size_t pmm_zone_free_frames(pmm_zone_t zone)
+{
+    return (zone < PMM_ZONE_COUNT) ? g_pmm_zones[zone].free : 0;
+}
+
+size_t pmm_zone_total_frames(pmm_zone_t zone)
+{
+    return (zone < PMM_ZONE_COUNT) ? g_pmm_zones[zone].total : 0;
+}
+
+/* -----------------------------------------------------------
+ * Descritores por frame (page_t)
+ * ----------------------------------------------------------- */
+
+size_t pmm_calc_pages_size_bytes(uint64_t phys_mem_size)
+{
+    return pmm_frames_for(phys_mem_size) * sizeof(page_t);
+}
+
+/**
+ * Conecta o vetor de descritores ao PMM. O que já está usado no bitmap
+ * (firmware, kernel, metadados, frames do boot) fica como reservado,
+ * sem referências; o resto, livre.
+ */
+void pmm_pages_init(page_t *pages)
+{
+    if (!pages) return;
+
+    for (size_t f = 0; f < g_pmm_total_frames; ++f) {
+        pages[f] = (page_t){
+            .type = PMM_TEST_BIT(g_pmm_bitmap, f) ? PAGE_TYPE_RESERVED : PAGE_TYPE_FREE
+        };
+    }
+    g_pmm_pages = pages;
+}
+
+page_t *phys_to_page(phys_addr_t phys)
+{
+    size_t frame_idx = pmm_addr_to_frame(phys);
+    if (!g_pmm_pages || frame_idx >= g_pmm_total_frames) return NULL;
+    return &g_pmm_pages[frame_idx];
+}
+
+phys_addr_t page_to_phys(const page_t *page)
+{
+    return pmm_frame_to_addr((size_t)(page - g_pmm_pages));
+}
+
+void page_get(phys_addr_t phys)
+{
+    page_t *page = phys_to_page(phys);
+    if (!page || page->refcount == 0) {
+        panic("page_get: frame livre ou reservado");
+    }
+    if (page->refcount == PAGE_REFCOUNT_MAX) {
+        panic("page_get: refcount estourou");
+    }
+    page->refcount++;
+}
+
+unsigned page_put(phys_addr_t phys)
+{
+    page_t *page = phys_to_page(phys);
+    if (!page || page->refcount == 0) {
+        panic("page_put: frame livre ou reservado");
+    }
+    if (page->flags & PG_PINNED) {
+        panic("page_put: frame fixo (PG_PINNED)");
+    }
+
+    if (--page->refcount == 0) {
+        pmm_release(pmm_addr_to_frame(phys), 1);
+        return 0;
+    }
+    return page->refcount;
+}
+
+unsigned page_count(phys_addr_t phys)
+{
+    page_t *page = phys_to_page(phys);
+    return page ? page->refcount : 0u;
+}
+
+void page_set_type(phys_addr_t phys, page_type_t type)
+{
+    page_t *page = phys_to_page(phys);
+    if (page && page->refcount) {
+        page->type = (uint8_t)type;
+    }
+}
+
+/* Exibe os frames livres e a ocupação de cada zona */
+void pmm_print_stats(void)
+{
+    kprintf("\nPMM: %u frames livres de %u", (unsigned)g_pmm_free_frames,
+            (unsigned)g_pmm_total_frames);
+    kprintf("\n  metadados: %u bytes + page_t: %u bytes", (unsigned)g_pmm_meta_size,
+            (unsigned)(g_pmm_pages ? g_pmm_total_frames * sizeof(page_t) : 0u));
+    kprintf("\n  cores: %u (coloracao %s)", (unsigned)g_pmm_colors,
+            pmm_coloring_enabled() ? "ligada" : "desligada");
+
+    for (unsigned z = 0; z < PMM_ZONE_COUNT; ++z) {
+        pmm_zone_info_t *zone = &g_pmm_zones[z];
+        unsigned used_pct = 0;
+        if (zone->total) {
+            used_pct = (unsigned)(((zone->total - zone->free) * 100u) / zone->total);
+        }
+        if (zone->end == zone->start) continue;
+
+        // em MiB: acima de 4 GiB o endereço não cabe no kprintf
+        kprintf("\n  zona %s [%u-%u MiB]: %u/%u livres (%u%% ocupada)",
+                g_pmm_zone_names[z],
+                (unsigned)(pmm_frame_to_addr(zone->start) >> 20),
+                (unsigned)(pmm_frame_to_addr(zone->end) >> 20),
+                (unsigned)zone->free, (unsigned)zone->total, used_pct);
+    }
+}
\ No newline at end of file
@@ -30,6 +30,7 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include "bootmem.h"
+#include "mm.h"
 
 //-----------------------------------------------------
 
@@ -38,9 +39,18 @@
 #define FRAME_SIZE        4096ull
 
 /* Tamanho máximo de memória física suportada pelo bitmap.
- * Ajuste conforme sua máquina/uso (ex.: 256 MiB, 512 MiB, 1 GiB...). */
-
+ * Ajuste conforme sua máquina/uso (ex.: 256 MiB, 512 MiB, 1 GiB...).
+ * Com PAE o limite sobe; o vetor de page_t (8 bytes por frame) precisa
+ * caber na janela identity do boot: 16 GiB -> 32 MiB de descritores.
+ * Sem PAE na CPU, mm.c limita a memória entregue ao PMM a 4 GiB. */
+
+#ifndef MAX_PHYS_MEM
+#if PAGING_PAE
+#define MAX_PHYS_MEM   (16ULL * 1024ULL * 1024ULL * 1024ULL) // 16 GiB
+#else
 #define MAX_PHYS_MEM   (4ULL * 1024ULL * 1024ULL * 1024ULL) // 4 GiB
+#endif
+#endif
 
 /* Número total de frames (cada um de 4 KiB) que cabem em MAX_PHYS_MEM. */
 #define MAX_FRAMES        (MAX_PHYS_MEM / FRAME_SIZE)
@@ -56,6 +66,125 @@
 #error "Overflow nas macros do PMM (use ULL)."
 #endif
 
+/* Usa o buddy allocator para servir os frames. Com 0, volta ao
+ * alocador puramente baseado no bitmap (varredura). */
+#ifndef PMM_BUDDY
+#define PMM_BUDDY 1
+#endif
+
+/* Com 1, as faixas do bitmap voltam a ser marcadas bit a bit e os
+ * livres contados bit a bit, como antes. Só serve para medir a diferença
+ * no tempo de pmm_init() (impresso por memory_setup). */
+#ifndef PMM_INIT_BITWISE
+#define PMM_INIT_BITWISE 0
+#endif
+
+/* Maior ordem do buddy: blocos de 2^PMM_MAX_ORDER frames (4 MiB). */
+#ifndef PMM_MAX_ORDER
+#define PMM_MAX_ORDER 10u
+#endif
+
+/* --------------------------------------------------------------------
+ * Coloração de páginas
+ *
+ * Cor de um frame = índice do frame módulo o número de cores
+ * (tamanho da cache / associatividade / FRAME_SIZE). Frames de mesma
+ * cor disputam os mesmos conjuntos da L2. Com a coloração ligada,
+ * mapeamentos virtualmente contíguos pedem cores sucessivas (a cor
+ * segue o VA) e um buffer grande se espalha por todos os conjuntos.
+ *
+ *  PMM_COLORING : estado inicial do modo (pmm_set_coloring() muda)
+ *  PMM_COLORS   : número de cores fixo; 0 = detectar pela CPUID folha 4
+ * ------------------------------------------------------------------ */
+
+#ifndef PMM_COLORING
+#define PMM_COLORING 0
+#endif
+
+#ifndef PMM_COLORS
+#define PMM_COLORS 0u
+#endif
+
+/* Blocos livres examinados por ordem antes de subir para a próxima */
+#ifndef PMM_COLOR_SCAN
+#define PMM_COLOR_SCAN 32u
+#endif
+
+/* --------------------------------------------------------------------
+ * Zonas de memória física
+ *
+ *  ZONE_DMA      : [0, 16 MiB)                 - DMA ISA / dispositivos limitados
+ *  ZONE_IDENTITY : [16 MiB, identity limit)    - janela identity-mapped do boot
+ *  ZONE_NORMAL   : [identity limit, 4 GiB)     - uso geral (heap, user, PTs)
+ *  ZONE_HIGH     : [4 GiB, fim)                - só existe com PAE; acessada
+ *                                                via kmap/paging_map
+ *
+ * Alocações comuns começam na zona mais alta e só descem para as zonas
+ * baixas quando a de cima se esgota. Os limites devem ser múltiplos do
+ * maior bloco do buddy para que nenhum bloco cruze duas zonas.
+ * ------------------------------------------------------------------ */
+
+#define PMM_ZONE_DMA_LIMIT       (16ULL * 1024ULL * 1024ULL)
+
+#ifndef PMM_ZONE_IDENTITY_LIMIT
+#define PMM_ZONE_IDENTITY_LIMIT  (64ULL * 1024ULL * 1024ULL)
+#endif
+
+#define PMM_ZONE_NORMAL_LIMIT    (4ULL * 1024ULL * 1024ULL * 1024ULL)
+
+#if (PMM_ZONE_DMA_LIMIT % (FRAME_SIZE << PMM_MAX_ORDER)) || \
+    (PMM_ZONE_IDENTITY_LIMIT % (FRAME_SIZE << PMM_MAX_ORDER))
+#error "Limites de zona devem ser múltiplos do maior bloco do buddy."
+#endif
+
+typedef enum {
+    ZONE_DMA = 0,
+    ZONE_IDENTITY,
+    ZONE_NORMAL,
+    ZONE_HIGH,
+    PMM_ZONE_COUNT
+} pmm_zone_t;
+
+/* --------------------------------------------------------------------
+ * Descritor por frame (struct page)
+ *
+ * Um vetor com um descritor por frame físico, alocado pelo boot_early
+ * logo depois do bitmap. Guarda contagem de referências, tipo (dono) e flags, base
+ * para compartilhar frames (página zero, COW, mapeamentos comuns).
+ * Limitado a 8 bytes por frame: 8/4096 = 0,2% da RAM.
+ *
+ *  - frame livre      : refcount 0, PAGE_TYPE_FREE
+ *  - frame reservado  : refcount 0, PAGE_TYPE_RESERVED (firmware, kernel)
+ *  - frame alocado    : refcount >= 1; page_put() libera ao chegar a 0
+ * ------------------------------------------------------------------ */
+
+typedef enum {
+    PAGE_TYPE_FREE = 0,
+    PAGE_TYPE_RESERVED,
+    PAGE_TYPE_KERNEL,       // padrão de toda alocação do PMM
+    PAGE_TYPE_HEAP,
+    PAGE_TYPE_PAGETABLE,
+    PAGE_TYPE_USER,
+    PAGE_TYPE_DMA,
+    PAGE_TYPE_SLAB          // página de um kmem_cache (slab.c)
+} page_type_t;
+
+/* Flags do descritor */
+#define PG_PINNED   (1u << 0)   // não pode ser liberado nem movido
+#define PG_COW      (1u << 1)   // compartilhado em copy-on-write
+#define PG_ZERO     (1u << 2)   // frame de zeros compartilhado (PTEs não contam ref)
+
+#define PAGE_REFCOUNT_MAX 0xFFFFu
+
+typedef struct page {
+    uint16_t refcount;
+    uint8_t  type;      // page_type_t
+    uint8_t  flags;     // PG_*
+    uint32_t priv;      // livre para o dono do frame
+} page_t;
+
+_Static_assert(sizeof(page_t) <= 8, "page_t deve ter no maximo 8 bytes");
+
 /* --------------------------------------------------------------------
  * Macros de manipulação de bits no bitmap
  * ------------------------------------------------------------------ */
@@ -87,6 +216,8 @@
 
 /* Inicializa o PMM.
  *
+ *  - bitmap_ini: área de pmm_calc_meta_size_bytes() bytes. O bitmap
+ *    ocupa o início e as estruturas do buddy vêm logo em seguida.
  *  - total_phys_mem_bytes: tamanho total de memória física detectada.
  *    (por exemplo, vindo da BIOS/multiboot).
  *
@@ -118,10 +249,64 @@ void pmm_mark_region_free(uintptr_t base_phys, size_t length);
  * Obs.: se você quiser tratar 0 como endereço válido, troque o valor
  * de erro para (uintptr_t) -1, por exemplo.
  */
-uintptr_t pmm_alloc_frame(void);
+phys_addr_t pmm_alloc_frame(void);
 
 /* Libera um frame físico (marca como livre) dado o endereço físico base. */
-void pmm_free_frame(uintptr_t frame_addr);
+void pmm_free_frame(phys_addr_t frame_addr);
+
+/* Aloca 2^order frames fisicamente contíguos, alinhados ao tamanho do
+ * bloco (FRAME_SIZE << order). Retorna o endereço físico base ou 0.
+ * pmm_alloc_frame() equivale a pmm_alloc_frames(0).
+ */
+phys_addr_t pmm_alloc_frames(unsigned order);
+
+/* Como pmm_alloc_frames(), mas começando pela zona indicada e descendo
+ * para as zonas abaixo dela se necessário (ex.: ZONE_DMA só usa DMA).
+ * Quem precisa de frame abaixo de 4 GiB pede ZONE_NORMAL. */
+phys_addr_t pmm_alloc_frames_zone(unsigned order, pmm_zone_t zone);
+
+/* Aloca 'size' bytes fisicamente contíguos para buffers de dispositivo.
+ *  align    : alinhamento do início (potência de 2; mínimo FRAME_SIZE)
+ *  boundary : o buffer não cruza múltiplos deste valor (0 = sem restrição)
+ *  max_phys : o buffer inteiro fica abaixo deste endereço (0 = sem limite)
+ * Retorna o endereço físico ou 0.
+ */
+phys_addr_t pmm_alloc_contig(size_t size, size_t align, size_t boundary, uint64_t max_phys);
+
+/* Libera um buffer obtido com pmm_alloc_contig(). */
+void pmm_free_contig(phys_addr_t addr, size_t size);
+
+/* Preenche out[0..n) com frames livres (não necessariamente contíguos)
+ * numa única passada. Retorna quantos foram obtidos (< n só se faltar
+ * memória). Cada frame é liberado individualmente com pmm_free_frame().
+ */
+size_t pmm_alloc_frames_bulk(phys_addr_t *out, size_t n);
+
+/* Libera um bloco obtido com pmm_alloc_frames(order). A ordem deve ser
+ * a mesma usada na alocação. Buddies livres são unidos automaticamente.
+ */
+void pmm_free_frames(phys_addr_t addr, unsigned order);
+
+/* Aloca um frame da cor indicada (módulo pmm_color_count()). Se não
+ * houver frame livre dessa cor, devolve um frame qualquer. */
+phys_addr_t pmm_alloc_frame_color(unsigned color);
+
+/* Frame para ser mapeado em 'va': com a coloração ligada a cor segue o
+ * VA; desligada, equivale a pmm_alloc_frame(). */
+phys_addr_t pmm_alloc_frame_for_va(uintptr_t va);
+
+/* Cor de um frame / de um VA e quantidade de cores (potência de 2) */
+unsigned pmm_frame_color(phys_addr_t phys);
+unsigned pmm_va_color(uintptr_t va);
+unsigned pmm_color_count(void);
+
+void pmm_set_coloring(bool enabled);
+bool pmm_coloring_enabled(void);
+
+#ifdef PMM_COLOR_BENCH
+/* Compara a varredura de um buffer com e sem coloração (pmm_bench.c) */
+void pmm_color_bench(void);
+#endif
 
 /* Retorna quantidade de frames livres. */
 size_t pmm_get_free_frame_count(void);
@@ -129,10 +314,93 @@ size_t pmm_get_free_frame_count(void);
 /* Retorna quantidade de memória física livre em bytes. */
 size_t pmm_get_free_memory_bytes(void);
 
+/* Frames livres / utilizáveis de uma zona. */
+size_t pmm_zone_free_frames(pmm_zone_t zone);
+size_t pmm_zone_total_frames(pmm_zone_t zone);
+
+/* Exibe frames livres e a ocupação de cada zona. */
+void pmm_print_stats(void);
+
 uintptr_t pmm_bitmap_end_addr(void);
 
 size_t pmm_calc_bitmap_size_bytes(uint64_t phys_mem_size);
 
+/* Tamanho total (bitmap + estruturas do buddy) que deve ser reservado
+ * e entregue a pmm_init(). */
+size_t pmm_calc_meta_size_bytes(uint64_t phys_mem_size);
+
+/* Tamanho do vetor de page_t (um descritor por frame). */
+size_t pmm_calc_pages_size_bytes(uint64_t phys_mem_size);
+
+/* Conecta o vetor de descritores (alocado pelo boot_early, logo após o
+ * bitmap). Chamado depois de pmm_init(), com a janela identity já
+ * cobrindo o vetor. Frames usados até aqui ficam PAGE_TYPE_RESERVED. */
+void pmm_pages_init(page_t *pages);
+
+/* Descritor do frame que contém 'phys' (NULL fora da memória gerida). */
+page_t *phys_to_page(phys_addr_t phys);
+
+/* Endereço físico do frame descrito por 'page'. */
+phys_addr_t page_to_phys(const page_t *page);
+
+/* Acrescenta uma referência a um frame já alocado. */
+void page_get(phys_addr_t phys);
+
+/* Remove uma referência; o frame volta ao PMM quando a contagem chega
+ * a zero. Retorna as referências restantes. Vale só para frames
+ * avulsos (ordem 0). */
+unsigned page_put(phys_addr_t phys);
+
+/* Referências atuais do frame (0 = livre ou reservado). */
+unsigned page_count(phys_addr_t phys);
+
+/* Define o tipo (dono) de um frame alocado. */
+void page_set_type(phys_addr_t phys, page_type_t type);
+
+/* --------------------------------------------------------------------
+ * Pool de frames zerados (pmm_zero.c)
+ *
+ * Estoque de frames já zerados, reposto no laço ocioso do kernel.
+ * PMM_ZERO_POOL_LOW/HIGH são as marcas d'água da reposição.
+ * ------------------------------------------------------------------ */
+
+#ifndef PMM_ZERO_POOL_LOW
+#define PMM_ZERO_POOL_LOW   32u
+#endif
+
+#ifndef PMM_ZERO_POOL_HIGH
+#define PMM_ZERO_POOL_HIGH  128u
+#endif
+
+/* Frames zerados por passada do laço ocioso */
+#ifndef PMM_ZERO_IDLE_BATCH
+#define PMM_ZERO_IDLE_BATCH 8u
+#endif
+
+typedef struct {
+    size_t count;       // frames atualmente no pool
+    size_t hits;        // pedidos servidos pelo pool
+    size_t misses;      // pedidos zerados na hora (pool vazio)
+    size_t refilled;    // frames zerados pelo laço ocioso
+} pmm_zero_pool_stats_t;
+
+/* Frame zerado: do pool ou, se vazio, zerado na hora. 0 sem memória. */
+phys_addr_t pmm_alloc_zeroed_frame(void);
+
+/* Lote de frames zerados; retorna quantos foram obtidos. */
+size_t pmm_alloc_zeroed_frames_bulk(phys_addr_t *out, size_t n);
+
+/* Versões que respeitam a cor do VA de destino (coloração ligada):
+ * procuram no pool um frame da cor certa antes de alocar e zerar. */
+phys_addr_t pmm_alloc_zeroed_frame_for_va(uintptr_t va);
+size_t pmm_alloc_zeroed_frames_for_va(phys_addr_t *out, size_t n, uintptr_t va);
+
+/* Repõe até 'budget' frames; retorna quantos foram zerados. */
+size_t pmm_zero_pool_refill(size_t budget);
+
+void pmm_zero_pool_get_stats(pmm_zero_pool_stats_t *out);
+void pmm_zero_pool_print_stats(void);
+
 // static inline uintptr_t virt_to_phys_kernel(uintptr_t virt)
 // {
 //     uintptr_t _kernel_virt_base=(uintptr_t)get_kernel_ini_vmm();
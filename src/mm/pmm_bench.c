@@ -0,0 +1,132 @@
+/* pmm_bench.c - Medições de boot do PMM
+ *
+ * Compilado apenas com -DPMM_COLOR_BENCH. memory_setup() chama
+ * pmm_color_bench() depois do kheap_init().
+ */
+
+#include "pmm.h"
+#include "../klib/kprintf.h"
+#include "../cpu/cpu.h"
+#include "./page/paging.h"
+
+#ifdef PMM_COLOR_BENCH
+
+/* Janela de VA livre usada só durante a medição */
+#ifndef PMM_COLOR_BENCH_VA
+#define PMM_COLOR_BENCH_VA     0xEF000000u
+#endif
+
+/* Tamanho do buffer (em páginas) e quantas varreduras medir */
+#ifndef PMM_COLOR_BENCH_PAGES
+#define PMM_COLOR_BENCH_PAGES  256u
+#endif
+
+#define PMM_COLOR_BENCH_PASSES 16u
+#define PMM_COLOR_BENCH_LINE   64u
+
+/* Frames usados para fragmentar a memória livre antes de medir */
+static phys_addr_t g_bench_frag[PMM_COLOR_BENCH_PAGES * 4u];
+static phys_addr_t g_bench_buf[PMM_COLOR_BENCH_PAGES];
+
+/* Deixa buracos espalhados: aloca 4x o buffer e devolve 1/4 escolhido
+ * por um LCG, para que frames livres de cores variadas fiquem soltos. */
+static size_t bench_fragment(void)
+{
+    size_t   n    = pmm_alloc_frames_bulk(g_bench_frag, PMM_COLOR_BENCH_PAGES * 4u);
+    uint32_t seed = 0x12345678u;
+
+    for (size_t i = 0; i < n; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        if (((seed >> 16) & 3u) == 0) {
+            pmm_free_frame(g_bench_frag[i]);
+            g_bench_frag[i] = 0;
+        }
+    }
+    return n;
+}
+
+static void bench_unfragment(size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        if (g_bench_frag[i]) pmm_free_frame(g_bench_frag[i]);
+    }
+}
+
+/* Mapeia o buffer, varre PASSES vezes (uma leitura por linha) e devolve
+ * os ciclos. Retorna 0 se faltar memória. */
+static uint64_t bench_run(bool coloring)
+{
+    paging_ctx_t *ctx = get_paging_ctx();
+    uintptr_t     va  = PMM_COLOR_BENCH_VA;
+    size_t        n   = 0;
+
+    pmm_set_coloring(coloring);
+    size_t frag = bench_fragment();
+
+    for (; n < PMM_COLOR_BENCH_PAGES; ++n, va += PAGE_SIZE) {
+        g_bench_buf[n] = pmm_alloc_frame_for_va(va);
+        if (!g_bench_buf[n] ||
+            paging_map(kernel_directory, ctx, va, g_bench_buf[n], PAGE_RW) != 0) {
+            break;
+        }
+    }
+
+    uint64_t cycles = 0;
+    if (n == PMM_COLOR_BENCH_PAGES) {
+        volatile uint32_t *p     = (volatile uint32_t *)PMM_COLOR_BENCH_VA;
+        size_t             words = PMM_COLOR_BENCH_PAGES * PAGE_SIZE / sizeof(uint32_t);
+        size_t             step  = PMM_COLOR_BENCH_LINE / sizeof(uint32_t);
+        uint32_t           sum   = 0;
+
+        for (size_t i = 0; i < words; i += step) p[i] = (uint32_t)i;   // aquece
+
+        uint64_t t0 = cpu_rdtsc();
+        for (unsigned pass = 0; pass < PMM_COLOR_BENCH_PASSES; ++pass) {
+            for (size_t i = 0; i < words; i += step) sum += p[i];
+        }
+        cycles = cpu_rdtsc() - t0;
+        (void)sum;
+    }
+
+    va = PMM_COLOR_BENCH_VA;
+    for (size_t i = 0; i < n; ++i, va += PAGE_SIZE) {
+        paging_unmap(kernel_directory, ctx, va);
+        pmm_free_frame(g_bench_buf[i]);
+    }
+    if (n < PMM_COLOR_BENCH_PAGES && g_bench_buf[n]) {
+        pmm_free_frame(g_bench_buf[n]);
+    }
+    bench_unfragment(frag);
+
+    return cycles;
+}
+
+static void bench_report(const char *label, uint64_t cycles)
+{
+    uint32_t lines = PMM_COLOR_BENCH_PASSES *
+                     (PMM_COLOR_BENCH_PAGES * PAGE_SIZE / PMM_COLOR_BENCH_LINE);
+    uint32_t c32   = (cycles >> 32) ? 0xFFFFFFFFu : (uint32_t)cycles;
+
+    kprintf("\n  %s: %u Kciclos, %u ciclos/linha", label,
+            (unsigned)(c32 >> 10), (unsigned)(c32 / lines));
+}
+
+/**
+ * Varre um buffer de PMM_COLOR_BENCH_PAGES páginas com a coloração
+ * desligada e ligada e compara os ciclos. Restaura o modo anterior.
+ */
+void pmm_color_bench(void)
+{
+    bool saved = pmm_coloring_enabled();
+
+    kprintf("\nPMM bench coloracao: %u paginas, %u cores, %u varreduras",
+            (unsigned)PMM_COLOR_BENCH_PAGES, pmm_color_count(),
+            (unsigned)PMM_COLOR_BENCH_PASSES);
+
+    bench_report("sem cor", bench_run(false));
+    bench_report("com cor", bench_run(true));
+
+    pmm_set_coloring(saved);
+}
+
+#endif /* PMM_COLOR_BENCH */
@@ -0,0 +1,211 @@
+/* pmm_zero.c - Pool de frames físicos já zerados
+ *
+ * Quase toda página que entra em serviço (heap, PTs, páginas de usuário)
+ * precisa começar zerada. Em vez de pagar kmap + clear de 4 KiB no
+ * caminho da alocação, mantemos um pequeno estoque de frames zerados,
+ * reposto pelo laço ocioso do kernel (quando a CPU faria hlt).
+ *
+ * Marcas d'água:
+ *  - abaixo de PMM_ZERO_POOL_LOW o pool passa a ser reposto;
+ *  - a reposição continua até PMM_ZERO_POOL_HIGH (histerese).
+ */
+
+#include "pmm.h"
+#include "../klib/memory.h"
+#include "../klib/kprintf.h"
+#include "../cpu/cpu.h"
+#include "./page/paging.h"
+#include "./page/paging_kmap.h"
+
+static phys_addr_t g_zero_pool[PMM_ZERO_POOL_HIGH];
+static size_t    g_zero_pool_count = 0;
+static bool      g_zero_refilling  = true;   // começa vazio: repor até HIGH
+
+static pmm_zero_pool_stats_t g_zero_stats;
+
+/* Zera um frame físico pelo physmap ou pelo slot ZERO do kmap */
+static void pmm_zero_frame(phys_addr_t phys)
+{
+    uintptr_t va = physmap_va(phys);
+    if (va) {
+        kmemzero((void *)va, FRAME_SIZE);
+        return;
+    }
+
+    // o slot não pode ser tomado por uma IRQ no meio
+    uint32_t flags = cpu_irq_save();
+    void *p = (void *)kmap_atomic(phys, KMAP_SLOT_ZERO);
+    kmemzero(p, FRAME_SIZE);
+    kunmap_atomic(KMAP_SLOT_ZERO);
+    cpu_irq_restore(flags);
+}
+
+static phys_addr_t pmm_zero_pool_pop(void)
+{
+    phys_addr_t phys  = 0;
+    uint32_t  flags = cpu_irq_save();
+
+    if (g_zero_pool_count > 0) {
+        phys = g_zero_pool[--g_zero_pool_count];
+        if (g_zero_pool_count < PMM_ZERO_POOL_LOW) {
+            g_zero_refilling = true;
+        }
+    }
+
+    cpu_irq_restore(flags);
+    return phys;
+}
+
+/**
+ * Devolve um frame zerado. Vem do pool quando há estoque (hit); senão o
+ * frame é alocado e zerado na hora (miss). Retorna 0 sem memória.
+ */
+phys_addr_t pmm_alloc_zeroed_frame(void)
+{
+    phys_addr_t phys = pmm_zero_pool_pop();
+    if (phys) {
+        g_zero_stats.hits++;
+        return phys;
+    }
+
+    phys = pmm_alloc_frame();
+    if (!phys) return 0;
+
+    g_zero_stats.misses++;
+    pmm_zero_frame(phys);
+    return phys;
+}
+
+/* Retira do pool um frame da cor pedida (0 se não houver) */
+static phys_addr_t pmm_zero_pool_take_color(unsigned color)
+{
+    phys_addr_t phys  = 0;
+    uint32_t    flags = cpu_irq_save();
+
+    for (size_t i = g_zero_pool_count; i-- > 0; ) {
+        if (pmm_frame_color(g_zero_pool[i]) == color) {
+            phys = g_zero_pool[i];
+            g_zero_pool[i] = g_zero_pool[--g_zero_pool_count];
+            if (g_zero_pool_count < PMM_ZERO_POOL_LOW) {
+                g_zero_refilling = true;
+            }
+            break;
+        }
+    }
+
+    cpu_irq_restore(flags);
+    return phys;
+}
+
+/**
+ * Frame zerado para mapear em 'va'. Com a coloração ligada, procura no
+ * pool um frame da cor do VA; se não houver, aloca um dessa cor e o
+ * zera na hora.
+ */
+phys_addr_t pmm_alloc_zeroed_frame_for_va(uintptr_t va)
+{
+    if (!pmm_coloring_enabled()) return pmm_alloc_zeroed_frame();
+
+    unsigned    color = pmm_va_color(va);
+    phys_addr_t phys  = pmm_zero_pool_take_color(color);
+    if (phys) {
+        g_zero_stats.hits++;
+        return phys;
+    }
+
+    phys = pmm_alloc_frame_color(color);
+    if (!phys) return 0;
+
+    g_zero_stats.misses++;
+    pmm_zero_frame(phys);
+    return phys;
+}
+
+/* Lote para as páginas [va, va + n*PAGE_SIZE) */
+size_t pmm_alloc_zeroed_frames_for_va(phys_addr_t *out, size_t n, uintptr_t va)
+{
+    if (!pmm_coloring_enabled()) return pmm_alloc_zeroed_frames_bulk(out, n);
+    if (!out) return 0;
+
+    size_t got = 0;
+    for (; got < n; ++got, va += PAGE_SIZE) {
+        out[got] = pmm_alloc_zeroed_frame_for_va(va);
+        if (!out[got]) break;
+    }
+    return got;
+}
+
+/**
+ * Versão em lote: consome o pool primeiro e completa com
+ * pmm_alloc_frames_bulk(), zerando o restante na hora.
+ */
+size_t pmm_alloc_zeroed_frames_bulk(phys_addr_t *out, size_t n)
+{
+    if (!out) return 0;
+
+    size_t got = 0;
+    while (got < n) {
+        phys_addr_t phys = pmm_zero_pool_pop();
+        if (!phys) break;
+        out[got++] = phys;
+    }
+    g_zero_stats.hits += got;
+
+    if (got < n) {
+        size_t extra = pmm_alloc_frames_bulk(out + got, n - got);
+        for (size_t i = 0; i < extra; ++i) {
+            pmm_zero_frame(out[got + i]);
+        }
+        g_zero_stats.misses += extra;
+        got += extra;
+    }
+
+    return got;
+}
+
+/**
+ * Repõe o pool com até 'budget' frames. Chamado do laço ocioso; retorna
+ * quantos frames foram zerados (0 = nada a fazer, pode executar hlt).
+ */
+size_t pmm_zero_pool_refill(size_t budget)
+{
+    size_t done = 0;
+
+    while (done < budget && g_zero_refilling) {
+        phys_addr_t phys = pmm_alloc_frame();
+        if (!phys) {
+            g_zero_refilling = false;   // sem memória: tenta de novo no próximo LOW
+            break;
+        }
+
+        pmm_zero_frame(phys);
+
+        uint32_t flags = cpu_irq_save();
+        g_zero_pool[g_zero_pool_count++] = phys;
+        if (g_zero_pool_count >= PMM_ZERO_POOL_HIGH) {
+            g_zero_refilling = false;
+        }
+        cpu_irq_restore(flags);
+
+        g_zero_stats.refilled++;
+        done++;
+    }
+
+    return done;
+}
+
+void pmm_zero_pool_get_stats(pmm_zero_pool_stats_t *out)
+{
+    if (!out) return;
+    *out       = g_zero_stats;
+    out->count = g_zero_pool_count;
+}
+
+void pmm_zero_pool_print_stats(void)
+{
+    kprintf("\nPMM zero pool: %u frames (low=%u high=%u) hits=%u misses=%u repostos=%u",
+            (unsigned)g_zero_pool_count,
+            (unsigned)PMM_ZERO_POOL_LOW, (unsigned)PMM_ZERO_POOL_HIGH,
+            (unsigned)g_zero_stats.hits, (unsigned)g_zero_stats.misses,
+            (unsigned)g_zero_stats.refilled);
+}
@@ -0,0 +1,302 @@
+// slab.c
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "./mm.h"
+#include "slab.h"
+#include "kheap.h"
+#include "pmm.h"
+#include "./page/paging_kmap.h"
+#include "../klib/memory.h"
+#include "../klib/kprintf.h"
+#include "../cpu/cpu.h"
+
+/* Cabeçalho no início de cada página do cache; a pilha de índices livres
+ * vem logo depois, seguida do mapa de livres (1 bit por objeto, 1 =
+ * livre) que barra o kmem_cache_free duplicado */
+typedef struct kmem_slab {
+    struct kmem_slab* next;
+    struct kmem_slab* prev;
+    kmem_cache_t*     cache;
+    uintptr_t         objs;         // primeiro objeto (depois da cor)
+    uint16_t          inuse;
+    uint16_t          free_top;     // entradas válidas em free[]
+    uint16_t          free[];
+} kmem_slab_t;
+
+struct kmem_cache {
+    const char*  name;              // NULL = slot livre
+    size_t       size;
+    size_t       align;
+    size_t       stride;
+    uint16_t     per_slab;
+    size_t       map_offset;        // mapa de livres (depois da pilha)
+    size_t       objs_offset;       // cabeçalho + pilha + mapa, alinhado
+    size_t       colour_step;
+    uint32_t     colours;           // deslocamentos possíveis (>= 1)
+    uint32_t     colour_next;
+    kmem_ctor_t  ctor;
+
+    kmem_slab_t* partial;           // com objetos livres e alocados
+    kmem_slab_t* full;
+    kmem_slab_t* empty;
+    size_t       nr_slabs;
+    size_t       nr_empty;
+    size_t       active;
+    size_t       allocs;
+    size_t       frees;
+};
+
+static kmem_cache_t g_kmem_caches[KMEM_CACHE_MAX];
+
+// -----------------------------------------------------------------------------
+// Listas de slabs
+// -----------------------------------------------------------------------------
+
+static void slab_list_del(kmem_slab_t** head, kmem_slab_t* s)
+{
+    if (s->prev) s->prev->next = s->next;
+    else         *head         = s->next;
+    if (s->next) s->next->prev = s->prev;
+    s->next = s->prev = NULL;
+}
+
+static void slab_list_add(kmem_slab_t** head, kmem_slab_t* s)
+{
+    s->prev = NULL;
+    s->next = *head;
+    if (*head) (*head)->prev = s;
+    *head = s;
+}
+
+/* Lista em que o slab deve estar dado o número de objetos em uso */
+static kmem_slab_t** slab_list_for(kmem_cache_t* c, uint16_t inuse)
+{
+    if (inuse == 0)           return &c->empty;
+    if (inuse == c->per_slab) return &c->full;
+    return &c->partial;
+}
+
+// -----------------------------------------------------------------------------
+// Páginas
+// -----------------------------------------------------------------------------
+
+/* Página nova do PMM, dentro do physmap (0 se não houver). O PMM já
+ * limita a busca ao physmap, da zona mais alta que ele cobre para baixo. */
+static phys_addr_t slab_page_alloc(void)
+{
+    if (g_physmap_size == 0) return 0;
+
+    phys_addr_t phys = pmm_alloc_contig(PAGE_SIZE, PAGE_SIZE, 0, (uint64_t)g_physmap_size);
+    if (phys && physmap_va(phys)) return phys;
+    if (phys) pmm_free_frame(phys);
+    return 0;
+}
+
+static inline uint32_t* slab_free_map(const kmem_cache_t* c, const kmem_slab_t* s)
+{
+    return (uint32_t*)((uintptr_t)s + c->map_offset);
+}
+
+static kmem_slab_t* slab_new(kmem_cache_t* c)
+{
+    phys_addr_t phys = slab_page_alloc();
+    if (!phys) return NULL;
+    page_set_type(phys, PAGE_TYPE_SLAB);
+
+    kmem_slab_t* s = (kmem_slab_t*)physmap_va(phys);
+    s->next     = s->prev = NULL;
+    s->cache    = c;
+    s->inuse    = 0;
+    s->free_top = c->per_slab;
+
+    // cor: próximo deslocamento, em passos da linha de cache
+    s->objs = (uintptr_t)s + c->objs_offset + (uintptr_t)c->colour_next * c->colour_step;
+    if (++c->colour_next >= c->colours) c->colour_next = 0;
+
+    // pilha de livres: o índice 0 sai primeiro; no mapa, todos livres
+    uint32_t* map = slab_free_map(c, s);
+    for (uint32_t w = 0; w < (c->per_slab + 31u) / 32u; ++w) map[w] = 0xFFFFFFFFu;
+    for (uint16_t i = 0; i < c->per_slab; ++i) {
+        s->free[i] = (uint16_t)(c->per_slab - 1u - i);
+        if (c->ctor) c->ctor((void*)(s->objs + (uintptr_t)i * c->stride));
+    }
+
+    c->nr_slabs++;
+    return s;
+}
+
+static void slab_release(kmem_cache_t* c, kmem_slab_t* s)
+{
+    c->nr_slabs--;
+    pmm_free_frame((phys_addr_t)((uintptr_t)s - PHYSMAP_BASE));
+}
+
+// -----------------------------------------------------------------------------
+// API
+// -----------------------------------------------------------------------------
+
+kmem_cache_t* kmem_cache_create(const char* name, size_t size, size_t align, kmem_ctor_t ctor)
+{
+    if (!name || size == 0) return NULL;
+    if (align == 0) align = HEAP_ALIGNMENT;
+    if (align & (align - 1u)) return NULL;
+
+    size_t stride = (size_t)ALIGN_UP(size, align);
+
+    // maior n tal que cabeçalho + pilha + n objetos caibam na página
+    size_t n = (PAGE_SIZE - sizeof(kmem_slab_t)) / stride;
+    size_t hdr = 0, map = 0;
+    for (; n > 0; --n) {
+        map = (size_t)ALIGN_UP(sizeof(kmem_slab_t) + n * sizeof(uint16_t), sizeof(uint32_t));
+        hdr = (size_t)ALIGN_UP(map + ((n + 31u) / 32u) * sizeof(uint32_t), align);
+        if (hdr + n * stride <= PAGE_SIZE) break;
+    }
+    if (n == 0) {
+        kprintf("\nkmem_cache_create: %s (%u bytes) nao cabe numa pagina", name, (unsigned)size);
+        return NULL;
+    }
+
+    kmem_cache_t* c = NULL;
+    for (uint32_t i = 0; i < KMEM_CACHE_MAX && !c; ++i) {
+        if (!g_kmem_caches[i].name) c = &g_kmem_caches[i];
+    }
+    if (!c) {
+        kprintf("\nkmem_cache_create: sem slots para %s", name);
+        return NULL;
+    }
+
+    kmemset(c, 0, sizeof(*c));
+    c->name        = name;
+    c->size        = size;
+    c->align       = align;
+    c->stride      = stride;
+    c->per_slab    = (uint16_t)n;
+    c->map_offset  = map;
+    c->objs_offset = hdr;
+    c->colour_step = (align > KMEM_CACHE_LINE) ? align : KMEM_CACHE_LINE;
+    c->colours     = (uint32_t)((PAGE_SIZE - hdr - n * stride) / c->colour_step) + 1u;
+    c->ctor        = ctor;
+    return c;
+}
+
+void* kmem_cache_alloc(kmem_cache_t* c)
+{
+    if (!c || !c->name) return NULL;
+
+    uint32_t     flags = cpu_irq_save();
+    kmem_slab_t* s     = c->partial;
+
+    if (!s && (s = c->empty) != NULL) {
+        slab_list_del(&c->empty, s);
+        c->nr_empty--;
+        slab_list_add(&c->partial, s);
+    }
+    if (!s && (s = slab_new(c)) != NULL) {
+        slab_list_add(&c->partial, s);
+    }
+    if (!s) {
+        cpu_irq_restore(flags);
+        return NULL;
+    }
+
+    uint16_t idx = s->free[--s->free_top];
+    slab_free_map(c, s)[idx / 32u] &= ~(1u << (idx % 32u));
+    if (++s->inuse == c->per_slab) {
+        slab_list_del(&c->partial, s);
+        slab_list_add(&c->full, s);
+    }
+    c->active++;
+    c->allocs++;
+
+    cpu_irq_restore(flags);
+    return (void*)(s->objs + (uintptr_t)idx * c->stride);
+}
+
+void* kmem_cache_zalloc(kmem_cache_t* c)
+{
+    void* obj = kmem_cache_alloc(c);
+    if (obj) kmemset(obj, 0, c->size);
+    return obj;
+}
+
+void kmem_cache_free(kmem_cache_t* c, void* obj)
+{
+    if (!c || !obj) return;
+
+    uintptr_t    va = (uintptr_t)obj;
+    kmem_slab_t* s  = (kmem_slab_t*)(va & ~(uintptr_t)(PAGE_SIZE - 1));
+
+    if (!physmap_contains_va(va) || s->cache != c || va < s->objs ||
+        (va - s->objs) % c->stride != 0 || s->inuse == 0) {
+        kprintf("\nkmem_cache_free: %p nao pertence ao cache %s", obj, c->name);
+        return;
+    }
+
+    uint32_t  idx = (uint32_t)((va - s->objs) / c->stride);
+    uint32_t* map = slab_free_map(c, s);
+
+    uint32_t flags = cpu_irq_save();
+
+    // já livre: liberação dupla (devolveria o objeto a dois donos)
+    if (idx >= c->per_slab || (map[idx / 32u] & (1u << (idx % 32u)))) {
+        cpu_irq_restore(flags);
+        kprintf("\nkmem_cache_free: %p nao pertence ao cache %s", obj, c->name);
+        return;
+    }
+    map[idx / 32u] |= 1u << (idx % 32u);
+
+    kmem_slab_t** from = slab_list_for(c, s->inuse);
+    s->free[s->free_top++] = (uint16_t)idx;
+    s->inuse--;
+    c->active--;
+    c->frees++;
+
+    kmem_slab_t** to = slab_list_for(c, s->inuse);
+    if (from != to) {
+        slab_list_del(from, s);
+        if (to == &c->empty && c->nr_empty >= KMEM_CACHE_EMPTY_KEEP) {
+            slab_release(c, s);
+        } else {
+            slab_list_add(to, s);
+            if (to == &c->empty) c->nr_empty++;
+        }
+    }
+
+    cpu_irq_restore(flags);
+}
+
+void kmem_cache_get_stats(const kmem_cache_t* c, kmem_cache_stats_t* out)
+{
+    if (!c || !out) return;
+
+    out->name     = c->name;
+    out->obj_size = c->size;
+    out->stride   = c->stride;
+    out->per_slab = c->per_slab;
+    out->slabs    = c->nr_slabs;
+    out->active   = c->active;
+    out->total    = c->nr_slabs * c->per_slab;
+    out->allocs   = c->allocs;
+    out->frees    = c->frees;
+}
+
+void kmem_cache_print_stats(void)
+{
+    kprintf("\nslab caches:");
+    for (uint32_t i = 0; i < KMEM_CACHE_MAX; ++i) {
+        const kmem_cache_t* c = &g_kmem_caches[i];
+        if (!c->name) continue;
+
+        kmem_cache_stats_t st;
+        kmem_cache_get_stats(c, &st);
+
+        // bytes pedidos pelos objetos vivos / bytes das páginas do cache
+        size_t bytes = st.slabs * PAGE_SIZE;
+        kprintf("\n  %s: %u B, %u/pag, %u/%u objetos, %u paginas, %u%% uso (%u allocs, %u frees)",
+                st.name, (unsigned)st.obj_size, (unsigned)st.per_slab,
+                (unsigned)st.active, (unsigned)st.total, (unsigned)st.slabs,
+                (unsigned)(bytes ? st.active * st.obj_size * 100u / bytes : 0u),
+                (unsigned)st.allocs, (unsigned)st.frees);
+    }
+}
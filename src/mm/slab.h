@@ -0,0 +1,77 @@
+// slab.h
+/*
+ * Caches de objetos de tamanho fixo (slab). Cada cache tira páginas
+ * inteiras do PMM (acessadas pelo physmap) e as divide em objetos do
+ * mesmo tamanho; alocar e liberar é tirar/devolver um índice de uma
+ * pilha, sem varrer o bitmap da kheap.
+ *
+ *   página (slab)
+ *   +-----------+-------------+---------+-------+-------+-----+-------+-------+
+ *   | cabeçalho | free[n] u16 | mapa n  |  cor  | obj 0 | ... | obj n | sobra |
+ *   +-----------+-------------+---------+-------+-------+-----+-------+-------+
+ *
+ * A cor desloca o primeiro objeto de cada slab em múltiplos da linha de
+ * cache, para que os objetos de mesmo índice não caiam todos no mesmo
+ * conjunto da cache. O mapa (1 bit por objeto) marca os livres, e um
+ * kmem_cache_free de objeto já livre é recusado.
+ */
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Quantidade de caches que podem ser criados */
+#ifndef KMEM_CACHE_MAX
+#define KMEM_CACHE_MAX 16u
+#endif
+
+/* Passo da coloração (linha de cache) */
+#ifndef KMEM_CACHE_LINE
+#define KMEM_CACHE_LINE 64u
+#endif
+
+/* Slabs vazios mantidos por cache antes de devolver páginas ao PMM */
+#ifndef KMEM_CACHE_EMPTY_KEEP
+#define KMEM_CACHE_EMPTY_KEEP 1u
+#endif
+
+typedef struct kmem_cache kmem_cache_t;
+
+/* Construtor: roda uma vez por objeto, quando o slab é criado. O objeto
+ * deve voltar a kmem_cache_free() no estado construído. */
+typedef void (*kmem_ctor_t)(void* obj);
+
+typedef struct {
+    const char* name;
+    size_t obj_size;        // tamanho pedido
+    size_t stride;          // distância entre objetos (com alinhamento)
+    size_t per_slab;        // objetos por página
+    size_t slabs;           // páginas em uso pelo cache
+    size_t active;          // objetos alocados
+    size_t total;           // objetos nas páginas (livres + alocados)
+    size_t allocs;
+    size_t frees;
+} kmem_cache_stats_t;
+
+/* Cria um cache de objetos de 'size' bytes alinhados em 'align' (0 =
+ * HEAP_ALIGNMENT). NULL se não houver slot ou se o objeto não couber
+ * numa página. 'name' deve continuar válido (normalmente um literal). */
+kmem_cache_t* kmem_cache_create(const char* name, size_t size, size_t align, kmem_ctor_t ctor);
+
+/* Objeto livre do cache (construído, se houver construtor); NULL sem memória */
+void* kmem_cache_alloc(kmem_cache_t* cache);
+
+/* Igual a kmem_cache_alloc(), com o objeto zerado (caches sem construtor) */
+void* kmem_cache_zalloc(kmem_cache_t* cache);
+
+/* Devolve 'obj' ao cache de onde veio */
+void kmem_cache_free(kmem_cache_t* cache, void* obj);
+
+void kmem_cache_get_stats(const kmem_cache_t* cache, kmem_cache_stats_t* out);
+
+/* Objetos e aproveitamento das páginas de todos os caches */
+void kmem_cache_print_stats(void);
+
+#endif
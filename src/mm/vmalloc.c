@@ -0,0 +1,212 @@
+// vmalloc.c
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "./mm.h"
+#include "vmalloc.h"
+#include "pmm.h"
+#include "./page/paging.h"
+#include "../klib/kprintf.h"
+
+/* Trecho livre [start, end) da janela */
+typedef struct {
+    uintptr_t start;
+    uintptr_t end;
+} vmalloc_range_t;
+
+/* Alocação viva: 'pages' mapeadas a partir de 'va' e a guarda logo após */
+typedef struct {
+    uintptr_t va;       // 0 = slot livre
+    size_t    pages;
+} vmalloc_area_t;
+
+/* Trechos livres são separados por alocações: nunca passam de áreas + 1 */
+#define VMALLOC_MAX_FREE_RANGES (VMALLOC_MAX_AREAS + 1u)
+
+static vmalloc_range_t g_vm_free[VMALLOC_MAX_FREE_RANGES];
+static uint32_t        g_vm_free_count = 0;
+
+static vmalloc_area_t  g_vm_areas[VMALLOC_MAX_AREAS];
+static size_t          g_vm_live  = 0;
+static size_t          g_vm_pages = 0;
+
+// -----------------------------------------------------------------------------
+// Lista livre (ordenada por endereço, vizinhos sempre unidos)
+// -----------------------------------------------------------------------------
+
+static void vm_free_remove(uint32_t idx)
+{
+    for (uint32_t i = idx; i + 1 < g_vm_free_count; ++i) {
+        g_vm_free[i] = g_vm_free[i + 1];
+    }
+    g_vm_free_count--;
+}
+
+/* Primeiro trecho com 'bytes' livres; corta do início dele */
+static uintptr_t vm_free_take(uintptr_t bytes)
+{
+    for (uint32_t i = 0; i < g_vm_free_count; ++i) {
+        vmalloc_range_t* r = &g_vm_free[i];
+        if (r->end - r->start < bytes) continue;
+
+        uintptr_t va = r->start;
+        r->start += bytes;
+        if (r->start == r->end) vm_free_remove(i);
+        return va;
+    }
+    return 0;
+}
+
+/* Devolve [start, end) à lista, unindo com os vizinhos */
+static void vm_free_give(uintptr_t start, uintptr_t end)
+{
+    uint32_t i = 0;
+    while (i < g_vm_free_count && g_vm_free[i].start < start) ++i;
+
+    bool join_prev = (i > 0) && g_vm_free[i - 1].end == start;
+    bool join_next = (i < g_vm_free_count) && g_vm_free[i].start == end;
+
+    if (join_prev && join_next) {
+        g_vm_free[i - 1].end = g_vm_free[i].end;
+        vm_free_remove(i);
+    } else if (join_prev) {
+        g_vm_free[i - 1].end = end;
+    } else if (join_next) {
+        g_vm_free[i].start = start;
+    } else {
+        for (uint32_t k = g_vm_free_count; k > i; --k) {
+            g_vm_free[k] = g_vm_free[k - 1];
+        }
+        g_vm_free[i].start = start;
+        g_vm_free[i].end   = end;
+        g_vm_free_count++;
+    }
+}
+
+/* Alocação viva que começa em 'va' (NULL se não houver) */
+static vmalloc_area_t* vm_area_find(uintptr_t va)
+{
+    if (!va) return NULL;
+    for (uint32_t i = 0; i < VMALLOC_MAX_AREAS; ++i) {
+        if (g_vm_areas[i].va == va) return &g_vm_areas[i];
+    }
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+// API
+// -----------------------------------------------------------------------------
+
+void vmalloc_init(void)
+{
+    g_vm_free[0].start = VMALLOC_BASE;
+    g_vm_free[0].end   = VMALLOC_END;
+    g_vm_free_count    = 1;
+
+    kprintf("\nvmalloc: janela %p - %p (%u MiB)", (void*)VMALLOC_BASE,
+            (void*)(VMALLOC_END - 1u), (unsigned)((VMALLOC_END - VMALLOC_BASE) >> 20));
+}
+
+void* vmalloc(size_t size)
+{
+    if (size == 0 || size > VMALLOC_END - VMALLOC_BASE) return NULL;
+
+    vmalloc_area_t* area = NULL;
+    for (uint32_t i = 0; i < VMALLOC_MAX_AREAS && !area; ++i) {
+        if (!g_vm_areas[i].va) area = &g_vm_areas[i];
+    }
+    if (!area) return NULL;
+
+    size_t    pages = (size_t)ALIGN_UP(size, PAGE_SIZE) / PAGE_SIZE;
+    uintptr_t span  = (uintptr_t)(pages + 1u) * PAGE_SIZE;   // + guarda
+    uintptr_t va    = vm_free_take(span);
+    if (!va) return NULL;
+
+    paging_ctx_t* ctx   = get_paging_ctx();
+    uint32_t      flags = PAGE_RW | paging_kernel_global();
+    phys_addr_t   frames[VMALLOC_FRAME_BATCH];
+
+    for (size_t done = 0; done < pages; ) {
+        uintptr_t cur  = va + (uintptr_t)done * PAGE_SIZE;
+        size_t    want = pages - done;
+        if (want > VMALLOC_FRAME_BATCH) want = VMALLOC_FRAME_BATCH;
+
+        size_t got = pmm_alloc_zeroed_frames_for_va(frames, want, cur);
+        if (got < want ||
+            paging_map_range(kernel_directory, ctx, cur, frames, got, flags) != 0) {
+            for (size_t i = 0; i < got; ++i) pmm_free_frame(frames[i]);
+            paging_unmap_release(kernel_directory, ctx, va, done);
+            vm_free_give(va, va + span);
+            return NULL;
+        }
+        done += got;
+    }
+
+    area->va    = va;
+    area->pages = pages;
+    g_vm_live++;
+    g_vm_pages += pages;
+    return (void*)va;
+}
+
+void vfree(void* addr)
+{
+    if (!addr) return;
+
+    uintptr_t       va = (uintptr_t)addr;
+    vmalloc_area_t* a  = vm_area_find(va);
+    if (!a) {
+        kprintf("\nvfree: %p nao foi alocado por vmalloc", addr);
+        return;
+    }
+
+    paging_unmap_release(kernel_directory, get_paging_ctx(), va, a->pages);
+    vm_free_give(va, va + (uintptr_t)(a->pages + 1u) * PAGE_SIZE);
+
+    g_vm_live--;
+    g_vm_pages -= a->pages;
+    a->va    = 0;
+    a->pages = 0;
+}
+
+size_t vmalloc_size(const void* addr)
+{
+    const vmalloc_area_t* a = vm_area_find((uintptr_t)addr);
+    return a ? a->pages * PAGE_SIZE : 0;
+}
+
+bool vmalloc_is_guard(uintptr_t va)
+{
+    if (!vmalloc_contains(va)) return false;
+
+    va &= ~(uintptr_t)(PAGE_SIZE - 1);
+    for (uint32_t i = 0; i < VMALLOC_MAX_AREAS; ++i) {
+        const vmalloc_area_t* a = &g_vm_areas[i];
+        if (a->va && va == a->va + (uintptr_t)a->pages * PAGE_SIZE) return true;
+    }
+    return false;
+}
+
+void vmalloc_get_stats(vmalloc_stats_t* out)
+{
+    if (!out) return;
+
+    out->areas        = g_vm_live;
+    out->pages        = g_vm_pages;
+    out->free_ranges  = g_vm_free_count;
+    out->largest_free = 0;
+    for (uint32_t i = 0; i < g_vm_free_count; ++i) {
+        size_t p = (size_t)((g_vm_free[i].end - g_vm_free[i].start) / PAGE_SIZE);
+        if (p > out->largest_free) out->largest_free = p;
+    }
+}
+
+void vmalloc_print_stats(void)
+{
+    vmalloc_stats_t st;
+    vmalloc_get_stats(&st);
+
+    kprintf("\nvmalloc: %u areas, %u paginas mapeadas, %u trechos livres (maior: %u paginas)",
+            (unsigned)st.areas, (unsigned)st.pages,
+            (unsigned)st.free_ranges, (unsigned)st.largest_free);
+}
@@ -0,0 +1,70 @@
+// vmalloc.h
+/*
+ * Área virtual do kernel para buffers grandes: contíguos no VA, feitos de
+ * frames avulsos do PMM. Cada alocação é seguida de uma página de guarda
+ * sem mapeamento, que transforma um estouro em #PF.
+ *
+ *   VMALLOC_BASE                                        VMALLOC_END
+ *   | área 1 ... | guarda | área 2 ... | guarda |  livre  ...  |
+ */
+#ifndef VMALLOC_H
+#define VMALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "./page/paging.h"
+
+/* Janela de VA: acima da área de medições e abaixo das PTs do kmap */
+#ifndef VMALLOC_BASE
+#define VMALLOC_BASE 0xF0000000u
+#endif
+
+#ifndef VMALLOC_END
+#define VMALLOC_END  0xFF800000u
+#endif
+
+/* Alocações simultâneas (a lista livre, ordenada por endereço, tem no
+ * máximo uma entrada a mais) */
+#ifndef VMALLOC_MAX_AREAS
+#define VMALLOC_MAX_AREAS 128u
+#endif
+
+/* Frames pedidos ao PMM e mapeados por vez */
+#ifndef VMALLOC_FRAME_BATCH
+#define VMALLOC_FRAME_BATCH 64u
+#endif
+
+typedef struct {
+    size_t areas;           // alocações vivas
+    size_t pages;           // páginas mapeadas (sem as guardas)
+    size_t free_ranges;     // trechos na lista livre
+    size_t largest_free;    // maior trecho livre, em páginas
+} vmalloc_stats_t;
+
+/* Prepara a lista livre com a janela inteira */
+void vmalloc_init(void);
+
+/* Reserva ALIGN_UP(size, PAGE_SIZE) bytes de VA (+1 página de guarda) e
+ * os mapeia com frames zerados. NULL se faltar VA, frames ou slots. */
+void* vmalloc(size_t size);
+
+/* Desfaz o mapeamento, devolve os frames e junta o VA à lista livre */
+void vfree(void* addr);
+
+/* Bytes mapeados da alocação que começa em 'addr' (0 se não for uma) */
+size_t vmalloc_size(const void* addr);
+
+/* 'va' é a página de guarda de alguma alocação */
+bool vmalloc_is_guard(uintptr_t va);
+
+/* 'va' está dentro da janela do vmalloc */
+static inline bool vmalloc_contains(uintptr_t va)
+{
+    return va >= VMALLOC_BASE && va < VMALLOC_END;
+}
+
+void vmalloc_get_stats(vmalloc_stats_t* out);
+void vmalloc_print_stats(void);
+
+#endif